@@ -8,6 +8,7 @@
  */
 
 #include "validate.hpp"
+#include "cost.hpp"
 
 /**
  * @namespace chihaya
@@ -50,7 +50,7 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
     try {
         list_params = internal_list::validate(shandle, version);
     } catch (std::exception& e) {
-        throw std::runtime_error(std::string("failed to load 'seeds' list; ") + e.what());
+        internal_misc::rethrow_with_context(e, "failed to load 'seeds' list", "seeds");
     }
     if (list_params.present.size() != list_params.length) {
         throw std::runtime_error("missing elements in the 'seeds' list");
@@ -63,13 +63,13 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
         size_t num_strings = 0;
 
         for (const auto& p : list_params.present) {
-            auto current = ritsuko::hdf5::open_group(shandle, p.second.c_str());
-
             ArrayDetails cur_seed;
+            internal_misc::ContextScope context(options, "failed to validate 'seeds/", p.name, "'", "seeds/");
             try {
+                auto current = internal_list::open_group(shandle, p);
                 cur_seed = ::chihaya::validate(current, version, options);
             } catch (std::exception& e) {
-                throw std::runtime_error("failed to validate 'seeds/" + p.second + "'; " + std::string(e.what()));
+                context.rethrow(e);
             }
 
             if (first) {
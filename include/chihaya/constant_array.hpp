@@ -69,6 +69,7 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
             throw std::runtime_error("'value' should be a scalar");
         }
 
+        internal_misc::ContextScope context(options, "failed to validate '", "value", "'", "");
         try {
             if (version.lt(1, 1, 0)) {
                 output.type = internal_type::translate_type_0_0(vhandle.getTypeClass());
@@ -87,7 +88,7 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
             }
 
         } catch (std::exception& e) {
-            throw std::runtime_error("failed to validate 'value'; " + std::string(e.what()));
+            context.rethrow(e);
         }
     }
 
@@ -0,0 +1,196 @@
+#ifndef CHIHAYA_COST_HPP
+#define CHIHAYA_COST_HPP
+
+#include "H5Cpp.h"
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <algorithm>
+#include <cstdint>
+
+#include "validate.hpp"
+#include "utils_public.hpp"
+#include "utils_file.hpp"
+
+/**
+ * @file cost.hpp
+ * @brief Cost estimates for realizing delayed objects.
+ */
+
+namespace chihaya {
+
+/**
+ * @brief Cost estimates for a delayed object.
+ *
+ * This aggregates the per-node estimates from `estimate_cost()`, e.g., for choosing the resources of a worker that will realize the delayed object.
+ */
+struct CostEstimate {
+    /**
+     * Estimates for each node in the delayed object, in the order in which they were encountered during validation.
+     * The first entry corresponds to the root node.
+     */
+    std::vector<NodeCost> nodes;
+
+    /**
+     * Total number of bytes used to store the datasets of all nodes in the file.
+     */
+    uint64_t stored_bytes = 0;
+
+    /**
+     * Total number of floating-point operations to realize the delayed object.
+     */
+    double flops = 0;
+
+    /**
+     * Estimated peak memory usage to realize the delayed object, in bytes.
+     * This is the largest `NodeCost::peak_memory_bytes` across all nodes, assuming that nodes are realized one at a time
+     * and that the results of each node's children are released once the node has been computed.
+     */
+    uint64_t peak_memory_bytes = 0;
+
+    /**
+     * Whether the final result is expected to be sparse.
+     */
+    bool sparse = false;
+};
+
+/**
+ * Check the structure of a delayed object and estimate the cost of realizing it.
+ * The estimates are derived from the `ArrayDetails` of each node, the storage of its datasets and the structure of the tree,
+ * without reading any of the array data.
+ * Only the cheap checks on shapes, types and attributes are performed, i.e., the scans that would be deferred by `Options::defer_scans` are skipped,
+ * along with the checks enabled by `Options::check_data_contents` and `Options::check_utf8_strings`;
+ * `validate()` should be used to fully validate the object.
+ *
+ * @param handle Open handle to a HDF5 group corresponding to a delayed operation or array.
+ * @param options Validation options, see `validate()` for details.
+ * On return, all options modified by this function are restored to their original values and `Options::node_costs` is empty.
+ *
+ * @return Cost estimates for the delayed object.
+ * If any of the checks failed, an error is raised.
+ */
+inline CostEstimate estimate_cost(const H5::Group& handle, Options& options) {
+    bool old_collect = options.collect_costs;
+    bool old_defer = options.defer_scans;
+    bool old_contents = options.check_data_contents;
+    bool old_utf8 = options.check_utf8_strings;
+    bool old_statistics = options.collect_sparse_statistics;
+    size_t old_queued = options.deferred_scans.size();
+    auto restore = [&]() -> void {
+        options.collect_costs = old_collect;
+        options.defer_scans = old_defer;
+        options.check_data_contents = old_contents;
+        options.check_utf8_strings = old_utf8;
+        options.collect_sparse_statistics = old_statistics;
+        options.deferred_scans.erase(options.deferred_scans.begin() + old_queued, options.deferred_scans.end());
+    };
+
+    // Scans are deferred and then discarded, so no array data is read.
+    options.collect_costs = true;
+    options.defer_scans = true;
+    options.check_data_contents = false;
+    options.check_utf8_strings = false;
+    options.collect_sparse_statistics = false;
+    options.node_costs.clear();
+
+    CostEstimate output;
+    try {
+        validate(handle, extract_version(handle), options);
+    } catch (...) {
+        restore();
+        options.node_costs.clear();
+        throw;
+    }
+
+    restore();
+    output.nodes.swap(options.node_costs);
+
+    for (const auto& node : output.nodes) {
+        output.stored_bytes += node.stored_bytes;
+        output.flops += node.flops;
+        output.peak_memory_bytes = std::max(output.peak_memory_bytes, node.peak_memory_bytes);
+    }
+    if (!output.nodes.empty()) {
+        output.sparse = output.nodes.front().sparse;
+    }
+
+    return output;
+}
+
+/**
+ * Check the structure of a delayed object in a HDF5 file and estimate the cost of realizing it.
+ *
+ * @param path Path to a HDF5 file.
+ * @param name Name of the group inside the file.
+ * @param options Validation options, see `estimate_cost()` for details.
+ * The file is opened with the settings in `Options::file_access`.
+ *
+ * @return Cost estimates for the delayed object.
+ */
+inline CostEstimate estimate_cost(const std::string& path, const std::string& name, Options& options) {
+    auto handle = internal_file::open(path, options.file_access);
+    auto ghandle = handle.openGroup(name);
+    return estimate_cost(ghandle, options);
+}
+
+/**
+ * Check the structure of a delayed object in a HDF5 file and estimate the cost of realizing it, using the default options.
+ *
+ * @param path Path to a HDF5 file.
+ * @param name Name of the group inside the file.
+ *
+ * @return Cost estimates for the delayed object.
+ */
+inline CostEstimate estimate_cost(const std::string& path, const std::string& name) {
+    Options options;
+    return estimate_cost(path, name, options);
+}
+
+/**
+ * @param estimate Cost estimates for a delayed object, typically from `estimate_cost()`.
+ * @return Human-readable summary of the estimates, with one line per node (indented by depth in the tree) followed by the totals.
+ */
+inline std::string explain(const CostEstimate& estimate) {
+    std::ostringstream out;
+
+    std::vector<size_t> depth(estimate.nodes.size());
+    for (size_t i = 0; i < estimate.nodes.size(); ++i) {
+        const auto& node = estimate.nodes[i];
+        if (node.parent != NodeCost::no_parent) {
+            depth[i] = depth[node.parent] + 1;
+        }
+
+        out << std::string(depth[i] * 2, ' ') << node.kind << " '" << node.name << "': ";
+        switch (node.details.type) {
+            case BOOLEAN: out << "BOOLEAN"; break;
+            case INTEGER: out << "INTEGER"; break;
+            case FLOAT: out << "FLOAT"; break;
+            case STRING: out << "STRING"; break;
+        }
+        out << " [";
+        for (size_t d = 0; d < node.details.dimensions.size(); ++d) {
+            if (d) {
+                out << " x ";
+            }
+            out << node.details.dimensions[d];
+        }
+        out << "]";
+        if (node.sparse) {
+            out << " sparse (" << node.nonzeros << " non-zeros)";
+        }
+        out << ", " << node.stored_bytes << " bytes stored, " << node.flops << " flops, " << node.peak_memory_bytes << " bytes at peak\n";
+    }
+
+    out << "total: " << estimate.stored_bytes << " bytes stored, " << estimate.flops << " flops, " << estimate.peak_memory_bytes << " bytes at peak";
+    if (estimate.sparse) {
+        out << ", sparse result";
+    }
+    out << "\n";
+
+    return out.str();
+}
+
+}
+
+#endif
@@ -10,6 +10,9 @@
 
 #include "utils_public.hpp"
 #include "utils_type.hpp"
+#include "utils_misc.hpp"
+#include "utils_string.hpp"
+#include "utils_content.hpp"
 #include "utils_dimnames.hpp"
 
 /**
@@ -33,7 +36,7 @@ namespace dense_array {
  * @return Details of the dense array.
  * Otherwise, if the validation failed, an error is raised.
  */
-inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& version, [[maybe_unused]] Options& options) {
+inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& version, Options& options) {
     ArrayDetails output;
 
     {
@@ -48,6 +51,7 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
         dspace.getSimpleExtentDims(dims.data());
         output.dimensions.insert(output.dimensions.end(), dims.begin(), dims.end());
 
+        internal_misc::ContextScope context(options, "failed to validate '", "data", "'", "");
         try {
             if (version.lt(1, 1, 0)) {
                 output.type = internal_type::translate_type_0_0(dhandle.getTypeClass());
@@ -64,12 +68,26 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
                 internal_misc::validate_missing_placeholder(dhandle, version);
             }
 
-            if (dhandle.getTypeClass() == H5T_STRING) {
-                ritsuko::hdf5::validate_nd_string_dataset(dhandle, dims, 1000000);
+            size_t total = 1;
+            for (auto d : dims) {
+                total *= d;
+            }
+
+            if (dhandle.getTypeClass() == H5T_STRING && internal_string::needs_scan(dhandle, options.check_utf8_strings)) {
+                internal_misc::scan_or_defer(dhandle, total, options, [=, check_utf8 = options.check_utf8_strings]() -> void {
+                    internal_string::validate_string_dataset(dhandle, dims, 1000000, check_utf8);
+                });
+            }
+
+            internal_content::Range range;
+            if (options.check_data_contents && !options.details_only && internal_content::needs_scan(dhandle, output.type, version, range)) {
+                internal_misc::scan_or_defer(dhandle, total, options, [=, num_threads = options.num_threads]() -> void {
+                    internal_content::scan_dataset(dhandle, dims, range, num_threads);
+                });
             }
 
         } catch (std::exception& e) {
-            throw std::runtime_error("failed to validate 'data'; " + std::string(e.what()));
+            context.rethrow(e);
         }
     }
 
@@ -96,7 +114,7 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
     // Do this before the 'native' check.
     if (!options.details_only) {
         if (handle.exists("dimnames")) {
-            internal_dimnames::validate(handle, output.dimensions, version);
+            internal_dimnames::validate(handle, output.dimensions, version, options);
         }
     }
 
@@ -32,7 +32,7 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
     }
 
     if (!options.details_only) {
-        internal_dimnames::validate(handle, seed_details.dimensions, version);
+        internal_dimnames::validate(handle, seed_details.dimensions, version, options);
     }
 
     return seed_details;
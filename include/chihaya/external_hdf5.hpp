@@ -5,7 +5,13 @@
 #include "ritsuko/ritsuko.hpp"
 #include "ritsuko/hdf5/hdf5.hpp"
 
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <filesystem>
+
 #include "minimal_array.hpp"
+#include "utils_file.hpp"
 
 /**
  * @file external_hdf5.hpp
@@ -20,6 +26,64 @@ namespace chihaya {
  */
 namespace external_hdf5 {
 
+/**
+ * @cond
+ */
+namespace internal {
+
+inline void resolve(const H5::DataSet& fhandle, const H5::DataSet& nhandle, const ArrayDetails& details, const std::string& container, Options& options) {
+    std::filesystem::path path(ritsuko::hdf5::load_scalar_string_dataset(fhandle));
+    if (path.is_relative()) {
+        if (!options.external_hdf5_directory.empty()) {
+            path = std::filesystem::path(options.external_hdf5_directory) / path;
+        } else if (internal_file::is_image(container)) {
+            throw std::runtime_error("cannot resolve relative path '" + path.string() + "' in 'file' for a file image without 'Options::external_hdf5_directory'");
+        } else {
+            path = std::filesystem::path(container).parent_path() / path;
+        }
+    }
+    auto name = ritsuko::hdf5::load_scalar_string_dataset(nhandle);
+
+    H5::DataSet dhandle;
+    try {
+        auto file = options.external_file_pool.open(path.string());
+        dhandle = file.openDataSet(name);
+    } catch (H5::Exception&) {
+        throw std::runtime_error("failed to open dataset '" + name + "' in external file '" + path.string() + "'");
+    }
+
+    auto dspace = dhandle.getSpace();
+    size_t ndims = dspace.getSimpleExtentNdims();
+    if (ndims != details.dimensions.size()) {
+        throw std::runtime_error("dimensionality of the external dataset should be equal to the length of 'dimensions'");
+    }
+    std::vector<hsize_t> dims(ndims);
+    dspace.getSimpleExtentDims(dims.data());
+    for (size_t d = 0; d < ndims; ++d) {
+        if (dims[ndims - d - 1] != static_cast<hsize_t>(details.dimensions[d])) {
+            throw std::runtime_error("extents of the external dataset should be equal to 'dimensions' (in reverse order)");
+        }
+    }
+
+    auto cls = dhandle.getTypeClass();
+    bool okay;
+    if (details.type == STRING) {
+        okay = (cls == H5T_STRING);
+    } else if (details.type == FLOAT) {
+        okay = (cls == H5T_FLOAT || cls == H5T_INTEGER);
+    } else {
+        okay = (cls == H5T_INTEGER);
+    }
+    if (!okay) {
+        throw std::runtime_error("datatype of the external dataset is not consistent with 'type'");
+    }
+}
+
+}
+/**
+ * @endcond
+ */
+
 /**
  * @param handle An open handle on a HDF5 group representing an external HDF5 array.
  * @param version Version of the **chihaya** specification.
@@ -47,6 +111,10 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
         if (!ritsuko::hdf5::is_utf8_string(nhandle)) {
             throw std::runtime_error("'name' should have a datatype that can be represented by a UTF-8 encoded string");
         }
+
+        if (options.resolve_external_hdf5) {
+            internal::resolve(fhandle, nhandle, deets, handle.getFileName(), options);
+        }
     }
 
     return deets;
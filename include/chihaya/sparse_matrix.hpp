@@ -6,11 +6,17 @@
 
 #include <vector>
 #include <cstdint>
+#include <type_traits>
+#include <cmath>
+#include <algorithm>
 
 #include "utils_public.hpp"
 #include "utils_misc.hpp"
 #include "utils_type.hpp"
 #include "utils_dimnames.hpp"
+#include "utils_stream.hpp"
+#include "utils_io.hpp"
+#include "utils_content.hpp"
 
 /**
  * @file sparse_matrix.hpp
@@ -30,10 +36,8 @@ namespace sparse_matrix {
  */
 namespace internal {
 
-template<typename Index_>
-void validate_indices(const H5::DataSet& ihandle, const std::vector<uint64_t>& indptrs, size_t primary, size_t secondary, bool csc) {
-    ritsuko::hdf5::Stream1dNumericDataset<Index_> stream(&ihandle, indptrs.back(), 1000000);
-
+template<typename Index_, class Stream_, class Visit_>
+void scan_indices(Stream_& stream, const std::vector<uint64_t>& indptrs, size_t primary, size_t secondary, bool csc, Visit_ visit) {
     for (size_t p = 0; p < primary; ++p) {
         auto start = indptrs[p];
         auto end = indptrs[p + 1];
@@ -45,20 +49,106 @@ void validate_indices(const H5::DataSet& ihandle, const std::vector<uint64_t>& i
         Index_ previous = 0;
         for (auto x = start; x < end; ++x, stream.next()) {
             auto i = stream.get();
-            if (i < 0) {
-                throw std::runtime_error("entries of 'indices' should be non-negative");
+            if constexpr(std::is_signed<Index_>::value) {
+                if (i < 0) {
+                    throw ValidationError(ErrorCode::INVALID_INDEX, "entries of 'indices' should be non-negative", x);
+                }
             }
             if (x > start && i <= previous) {
-                throw std::runtime_error("'indices' should be strictly increasing within each " + (csc ? std::string("column") : std::string("row")));
+                throw ValidationError(ErrorCode::INVALID_INDEX, "'indices' should be strictly increasing within each " + (csc ? std::string("column") : std::string("row")), x);
             }
             if (static_cast<size_t>(i) >= secondary) {
-                throw std::runtime_error("entries of 'indices' should be less than the number of " + (csc ? std::string("row") : std::string("column")) + "s");
+                throw ValidationError(ErrorCode::INVALID_INDEX, "entries of 'indices' should be less than the number of " + (csc ? std::string("row") : std::string("column")) + "s", x);
             }
             previous = i;
+            visit(p, i);
         }
     }
 }
 
+template<typename Index_>
+void validate_indices(const H5::DataSet& ihandle, const std::vector<uint64_t>& indptrs, size_t primary, size_t secondary, bool csc, int num_threads) {
+    internal_stream::stream_1d_numeric_dataset<Index_>(ihandle, indptrs.back(), 1000000, num_threads, [&](auto& stream) -> void {
+        scan_indices<Index_>(stream, indptrs, primary, secondary, csc, [](size_t, Index_) -> void {});
+    });
+}
+
+struct Placeholder {
+    bool present = false;
+    double value = 0;
+};
+
+inline Placeholder load_placeholder(const H5::DataSet& dhandle, const ritsuko::Version& version) {
+    Placeholder output;
+    const char* placeholder = "missing_placeholder";
+    if (version.major > 0 && dhandle.attrExists(placeholder)) {
+        output.present = true;
+        dhandle.openAttribute(placeholder).read(H5::PredType::NATIVE_DOUBLE, &output.value);
+    }
+    return output;
+}
+
+// Streams 'data' alongside 'indices' so that the statistics are computed in
+// the same pass as the index checks.
+template<typename Index_>
+void validate_indices_and_data(
+    const H5::DataSet& ihandle,
+    const H5::DataSet& dhandle,
+    const std::vector<uint64_t>& indptrs,
+    size_t primary,
+    size_t secondary,
+    bool csc,
+    const Placeholder& placeholder,
+    int num_threads,
+    SparseStatistics& stats)
+{
+    auto& primary_nonzeros = (csc ? stats.column_nonzeros : stats.row_nonzeros);
+    primary_nonzeros.resize(primary);
+    auto& secondary_nonzeros = (csc ? stats.row_nonzeros : stats.column_nonzeros);
+    secondary_nonzeros.resize(secondary);
+    auto& primary_sums = (csc ? stats.column_sums : stats.row_sums);
+    primary_sums.resize(primary);
+    auto& secondary_sums = (csc ? stats.row_sums : stats.column_sums);
+    secondary_sums.resize(secondary);
+    auto& primary_sumsq = (csc ? stats.column_sums_of_squares : stats.row_sums_of_squares);
+    primary_sumsq.resize(primary);
+    auto& secondary_sumsq = (csc ? stats.row_sums_of_squares : stats.column_sums_of_squares);
+    secondary_sumsq.resize(secondary);
+    bool nan_placeholder = placeholder.present && std::isnan(placeholder.value);
+
+    auto nnz = indptrs.back();
+    internal_io::with_service([&]() -> void {
+        internal_stream::stream_1d_numeric_dataset<Index_>(ihandle, nnz, 1000000, num_threads, [&](auto& istream) -> void {
+            internal_stream::stream_1d_numeric_dataset<double>(dhandle, nnz, 1000000, num_threads, [&](auto& dstream) -> void {
+                scan_indices<Index_>(istream, indptrs, primary, secondary, csc, [&](size_t p, Index_ i) -> void {
+                    ++primary_nonzeros[p];
+                    ++secondary_nonzeros[i];
+
+                    double val = dstream.get();
+                    dstream.next();
+                    if (std::isnan(val)) {
+                        if (nan_placeholder) {
+                            ++stats.placeholder_count;
+                        } else {
+                            ++stats.nan_count;
+                        }
+                    } else if (placeholder.present && val == placeholder.value) {
+                        ++stats.placeholder_count;
+                    } else {
+                        stats.minimum = std::min(stats.minimum, val);
+                        stats.maximum = std::max(stats.maximum, val);
+                        primary_sums[p] += val;
+                        secondary_sums[i] += val;
+                        double sq = val * val;
+                        primary_sumsq[p] += sq;
+                        secondary_sumsq[i] += sq;
+                    }
+                });
+            });
+        });
+    });
+}
+
 }
 /**
  * @endcond
@@ -72,7 +162,7 @@ void validate_indices(const H5::DataSet& ihandle, const std::vector<uint64_t>& i
  * @return Details of the sparse matrix.
  * Otherwise, if the validation failed, an error is raised.
  */
-inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& version, [[maybe_unused]] Options& options) {
+inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& version, Options& options) {
     std::vector<uint64_t> dims(2);
     ArrayType array_type;
 
@@ -105,6 +195,7 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
     {
         auto dhandle = ritsuko::hdf5::open_dataset(handle, "data");
 
+        internal_misc::ContextScope context(options, "failed to validate '", "data", "'", "");
         try {
             nnz = ritsuko::hdf5::get_1d_length(dhandle, false);
 
@@ -124,8 +215,15 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
             }
 
             internal_misc::validate_missing_placeholder(dhandle, version);
+
+            internal_content::Range range;
+            if (options.check_data_contents && !options.details_only && internal_content::needs_scan(dhandle, array_type, version, range)) {
+                internal_misc::scan_or_defer(dhandle, nnz, options, [=, num_threads = options.num_threads]() -> void {
+                    internal_content::scan_dataset(dhandle, std::vector<hsize_t>{ nnz }, range, num_threads);
+                });
+            }
         } catch (std::exception& e) {
-            throw std::runtime_error("failed to validate 'data'; " + std::string(e.what()));
+            context.rethrow(e);
         }
     }
 
@@ -175,25 +273,49 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
             if (ritsuko::hdf5::get_1d_length(iphandle, false) != static_cast<size_t>(primary + 1)) {
                 throw std::runtime_error("'indptr' should have length equal to the number of " + (csc ? std::string("columns") : std::string("rows")) + " plus 1");
             }
-            std::vector<uint64_t> indptrs(primary + 1);
-            iphandle.read(indptrs.data(), H5::PredType::NATIVE_UINT64);
-            if (indptrs[0] != 0) {
-                throw std::runtime_error("first entry of 'indptr' should be 0 for a sparse matrix");
-            }
-            if (indptrs.back() != static_cast<uint64_t>(nnz)) {
-                throw std::runtime_error("last entry of 'indptr' should be equal to the length of 'data'");
+            // Reserving a slot now so that the statistics are reported in the order of traversal, even if the scans are deferred.
+            bool collect = options.collect_sparse_statistics;
+            H5::DataSet dhandle;
+            internal::Placeholder placeholder;
+            size_t stat_index = options.sparse_statistics.size();
+            if (collect) {
+                dhandle = ritsuko::hdf5::open_dataset(handle, "data");
+                placeholder = internal::load_placeholder(dhandle, version);
+                options.sparse_statistics.emplace_back();
+                options.sparse_statistics.back().name = handle.getObjName();
             }
 
+            auto scan = [&](auto x) -> void {
+                typedef decltype(x) Index_;
+                internal_misc::scan_or_defer(ihandle, nnz, options, [=, num_threads = options.num_threads, optr = &options]() -> void {
+                    std::vector<uint64_t> indptrs(primary + 1);
+                    internal_io::serialize([&]() -> void {
+                        iphandle.read(indptrs.data(), H5::PredType::NATIVE_UINT64);
+                    });
+                    if (indptrs[0] != 0) {
+                        throw std::runtime_error("first entry of 'indptr' should be 0 for a sparse matrix");
+                    }
+                    if (indptrs.back() != static_cast<uint64_t>(nnz)) {
+                        throw std::runtime_error("last entry of 'indptr' should be equal to the length of 'data'");
+                    }
+                    if (collect) {
+                        internal::validate_indices_and_data<Index_>(ihandle, dhandle, indptrs, primary, secondary, csc, placeholder, num_threads, optr->sparse_statistics[stat_index]);
+                    } else {
+                        internal::validate_indices<Index_>(ihandle, indptrs, primary, secondary, csc, num_threads);
+                    }
+                });
+            };
+
             if (version.lt(1, 1, 0)) {
-                internal::validate_indices<int>(ihandle, indptrs, primary, secondary, csc);
+                scan(static_cast<int>(0));
             } else {
-                internal::validate_indices<uint64_t>(ihandle, indptrs, primary, secondary, csc);
+                internal_misc::visit_unsigned_index_type(ihandle, scan);
             }
         }
 
         // Validating dimnames.
         if (handle.exists("dimnames")) {
-            internal_dimnames::validate(handle, dims, version);
+            internal_dimnames::validate(handle, dims, version, options);
         }
     }
 
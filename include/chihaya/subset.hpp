@@ -40,7 +40,7 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
     auto& seed_dims = seed_details.dimensions;
 
     auto ihandle = ritsuko::hdf5::open_group(handle, "index");
-    auto collected = internal_subset::validate_index_list(ihandle, seed_dims, version);
+    auto collected = internal_subset::validate_index_list(ihandle, seed_dims, version, options);
     for (auto p : collected) {
         seed_dims[p.first] = p.second;
     }
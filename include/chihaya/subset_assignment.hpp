@@ -48,7 +48,7 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
         }
 
         auto ihandle = ritsuko::hdf5::open_group(handle, "index");
-        auto collected = internal_subset::validate_index_list(ihandle, seed_dims, version);
+        auto collected = internal_subset::validate_index_list(ihandle, seed_dims, version, options);
         auto expected_dims = seed_dims;
         for (auto p : collected) {
             expected_dims[p.first] = p.second;
@@ -61,6 +61,7 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
     if (side != "none") {
         auto vhandle = ritsuko::hdf5::open_dataset(handle, "value");
         
+        internal_misc::ContextScope context(options, "failed to validate '", "value", "'", "");
         try {
             if (version.lt(1, 1, 0)) {
                 if (vhandle.getTypeClass() == H5T_STRING) {
@@ -94,7 +95,7 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
             }
 
         } catch (std::exception& e) {
-            throw std::runtime_error("failed to validate 'value'; " + std::string(e.what()));
+            context.rethrow(e);
         }
     }
 
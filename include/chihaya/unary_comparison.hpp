@@ -11,6 +11,7 @@
 #include "utils_comparison.hpp"
 #include "utils_unary.hpp"
 #include "utils_misc.hpp"
+#include "utils_string.hpp"
 #include "utils_type.hpp"
 
 /**
@@ -50,6 +51,7 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
 
         // Checking the value.
         auto vhandle = ritsuko::hdf5::open_dataset(handle, "value");
+        internal_misc::ContextScope context(options, "failed to validate '", "value", "'", "");
         try {
             if (version.lt(1, 1, 0)) {
                 if ((seed_details.type == STRING) != (vhandle.getTypeClass() == H5T_STRING)) {
@@ -76,8 +78,10 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
                 hsize_t extent;
                 vhandle.getSpace().getSimpleExtentDims(&extent);
                 internal_unary::check_along(handle, version, seed_details.dimensions, extent);
-                if (vhandle.getTypeClass() == H5T_STRING) {
-                    ritsuko::hdf5::validate_1d_string_dataset(vhandle, extent, 1000000);
+                if (vhandle.getTypeClass() == H5T_STRING && internal_string::needs_scan(vhandle, options.check_utf8_strings)) {
+                    internal_misc::scan_or_defer(vhandle, extent, options, [=, check_utf8 = options.check_utf8_strings]() -> void {
+                        internal_string::validate_string_dataset(vhandle, std::vector<hsize_t>{ extent }, 1000000, check_utf8);
+                    });
                 }
 
             } else { 
@@ -85,7 +89,7 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
             }
 
         } catch (std::exception& e) {
-            throw std::runtime_error("failed to validate 'value'; " + std::string(e.what()));
+            context.rethrow(e);
         }
     }
 
@@ -53,6 +53,7 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
             // Checking the value.
             auto vhandle = ritsuko::hdf5::open_dataset(handle, "value");
 
+            internal_misc::ContextScope context(options, "failed to validate '", "value", "'", "");
             try {
                 if (version.lt(1, 1, 0)) {
                     if (vhandle.getTypeClass() == H5T_STRING) {
@@ -80,7 +81,7 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
                     throw std::runtime_error("dataset should be scalar or 1-dimensional");
                 }
             } catch (std::exception& e) {
-                throw std::runtime_error("failed to validate 'value'; " + std::string(e.what()));
+                context.rethrow(e);
             }
         }
     }
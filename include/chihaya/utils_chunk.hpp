@@ -0,0 +1,178 @@
+#ifndef CHIHAYA_UTILS_CHUNK_HPP
+#define CHIHAYA_UTILS_CHUNK_HPP
+
+#include "H5Cpp.h"
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <algorithm>
+
+#if defined(CHIHAYA_USE_ZLIB) && H5_VERSION_GE(1, 10, 5)
+#define CHIHAYA_USE_DIRECT_CHUNKS
+#include "zlib.h"
+#endif
+
+namespace chihaya {
+
+namespace internal_chunk {
+
+/*
+ * Direct reads of the raw (compressed) chunks of a 1-dimensional dataset, so
+ * that the decompression can be performed outside of the HDF5 library, e.g.,
+ * in parallel on multiple threads. This is only supported for pipelines that
+ * consist of shuffle and/or deflate filters, where every chunk is allocated
+ * and the stored datatype is identical to the requested in-memory datatype.
+ */
+struct Layout {
+    bool supported = false;
+    hsize_t chunk_length = 0;
+    size_t element_size = 0;
+    std::vector<H5Z_filter_t> filters; // in the order of application during writing.
+};
+
+inline Layout inspect(const H5::DataSet& handle, const H5::DataType& memtype, hsize_t length) {
+    Layout output;
+
+#ifdef CHIHAYA_USE_DIRECT_CHUNKS
+    auto cplist = handle.getCreatePlist();
+    if (cplist.getLayout() != H5D_CHUNKED || cplist.getNfilters() == 0) {
+        return output;
+    }
+
+    auto dspace = handle.getSpace();
+    if (dspace.getSimpleExtentNdims() != 1) {
+        return output;
+    }
+    hsize_t extent;
+    dspace.getSimpleExtentDims(&extent);
+    if (extent < length || length == 0) {
+        return output;
+    }
+
+    {
+        auto dtype = handle.getDataType();
+        if (!(dtype == memtype)) {
+            return output;
+        }
+    }
+    output.element_size = memtype.getSize();
+
+    cplist.getChunk(1, &output.chunk_length);
+    int nfilters = cplist.getNfilters();
+    for (int f = 0; f < nfilters; ++f) {
+        unsigned int flags;
+        size_t nelmts = 0;
+        unsigned int filter_config;
+        auto id = cplist.getFilter(f, flags, nelmts, NULL, 0, NULL, filter_config);
+        if (id != H5Z_FILTER_DEFLATE && id != H5Z_FILTER_SHUFFLE) {
+            return output;
+        }
+        output.filters.push_back(id);
+    }
+
+    hsize_t nchunks = 0;
+    if (H5Dget_num_chunks(handle.getId(), dspace.getId(), &nchunks) < 0) {
+        return output;
+    }
+    if (nchunks != (extent + output.chunk_length - 1) / output.chunk_length) { // unallocated chunks would need to be filled.
+        return output;
+    }
+
+    output.supported = true;
+#else
+    (void)handle;
+    (void)memtype;
+    (void)length;
+#endif
+
+    return output;
+}
+
+struct RawChunk {
+    std::vector<unsigned char> bytes;
+    uint32_t mask = 0; // bit 'i' is set if the i-th filter was skipped for this chunk.
+};
+
+// Reads the raw bytes of the chunk at position 'index'. This must be called
+// from the thread that is responsible for HDF5 calls.
+inline RawChunk read_raw(const H5::DataSet& handle, const Layout& layout, hsize_t index) {
+    RawChunk output;
+#ifdef CHIHAYA_USE_DIRECT_CHUNKS
+    hsize_t offset = index * layout.chunk_length;
+    hsize_t nbytes = 0;
+    if (H5Dget_chunk_storage_size(handle.getId(), &offset, &nbytes) < 0) {
+        throw std::runtime_error("failed to retrieve the size of chunk " + std::to_string(index));
+    }
+    output.bytes.resize(nbytes);
+    if (H5Dread_chunk(handle.getId(), H5P_DEFAULT, &offset, &output.mask, output.bytes.data()) < 0) {
+        throw std::runtime_error("failed to read chunk " + std::to_string(index));
+    }
+#else
+    (void)handle;
+    (void)layout;
+    (void)index;
+#endif
+    return output;
+}
+
+// Reverses the filter pipeline on the raw bytes, storing the result in
+// 'output', which should have space for a full chunk. No HDF5 calls are
+// involved, so this can be called from any thread.
+inline void decode(RawChunk& chunk, const Layout& layout, unsigned char* output) {
+#ifdef CHIHAYA_USE_DIRECT_CHUNKS
+    auto& raw = chunk.bytes;
+    auto mask = chunk.mask;
+    size_t full = layout.chunk_length * layout.element_size;
+    std::vector<unsigned char> workspace;
+
+    for (size_t i = layout.filters.size(); i > 0; --i) {
+        size_t f = i - 1;
+        if (mask & (static_cast<uint32_t>(1) << f)) {
+            continue;
+        }
+
+        if (layout.filters[f] == H5Z_FILTER_DEFLATE) {
+            workspace.resize(full);
+            uLongf destlen = full;
+            if (uncompress(workspace.data(), &destlen, raw.data(), raw.size()) != Z_OK || destlen != full) {
+                throw std::runtime_error("failed to inflate a deflate-compressed chunk");
+            }
+        } else { // shuffle.
+            if (raw.size() != full) {
+                throw std::runtime_error("unexpected size of a shuffled chunk");
+            }
+            workspace.resize(full);
+            size_t esize = layout.element_size;
+            size_t nelements = full / esize;
+            for (size_t b = 0; b < esize; ++b) {
+                const unsigned char* src = raw.data() + b * nelements;
+                for (size_t e = 0; e < nelements; ++e) {
+                    workspace[e * esize + b] = src[e];
+                }
+            }
+            size_t leftover = nelements * esize; // trailing bytes are not shuffled.
+            std::copy(raw.begin() + leftover, raw.end(), workspace.begin() + leftover);
+        }
+
+        raw.swap(workspace);
+    }
+
+    if (raw.size() != full) {
+        throw std::runtime_error("unexpected size of a decoded chunk");
+    }
+    std::memcpy(output, raw.data(), full);
+#else
+    (void)chunk;
+    (void)layout;
+    (void)output;
+#endif
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,158 @@
+#ifndef CHIHAYA_UTILS_CONTENT_HPP
+#define CHIHAYA_UTILS_CONTENT_HPP
+
+#include "H5Cpp.h"
+#include "ritsuko/ritsuko.hpp"
+#include "ritsuko/hdf5/hdf5.hpp"
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+#include <exception>
+
+#include "utils_public.hpp"
+#include "utils_io.hpp"
+
+namespace chihaya {
+
+namespace internal_content {
+
+/*
+ * Deep checks of numeric 'data' contents, i.e., that BOOLEAN values are 0 or 1
+ * and that INTEGER values fit into a 32-bit signed integer. Values equal to
+ * the missing placeholder are always allowed. All values are read as 64-bit
+ * integers; HDF5 clamps anything larger, which is still out of range.
+ */
+struct Range {
+    int64_t lower = 0;
+    int64_t upper = 0;
+    bool has_placeholder = false;
+    int64_t placeholder = 0;
+    const char* message = "";
+};
+
+// Returns true if a scan is needed for an array of the given type, in which
+// case 'range' is filled with the allowed values. Integer datasets whose type
+// already guarantees a fit do not need to be scanned.
+inline bool needs_scan(const H5::DataSet& handle, ArrayType type, const ritsuko::Version& version, Range& range) {
+    if (handle.getTypeClass() != H5T_INTEGER) {
+        return false;
+    }
+
+    if (type == BOOLEAN) {
+        range.lower = 0;
+        range.upper = 1;
+        range.message = "expected 0 or 1 in a boolean dataset (stricter than the specification, which treats any non-zero value as true)";
+    } else if (type == INTEGER) {
+        if (!ritsuko::hdf5::exceeds_integer_limit(handle, 32, true)) {
+            return false;
+        }
+        range.lower = std::numeric_limits<int32_t>::min();
+        range.upper = std::numeric_limits<int32_t>::max();
+        range.message = "expected values of an integer dataset to fit into a 32-bit signed integer (stricter than the specification)";
+    } else {
+        return false;
+    }
+
+    const char* placeholder = "missing_placeholder";
+    if (version.major > 0 && handle.attrExists(placeholder)) {
+        range.has_placeholder = true;
+        handle.openAttribute(placeholder).read(H5::PredType::NATIVE_INT64, &range.placeholder);
+    }
+
+    return true;
+}
+
+// Branch-free reduction so that the compiler can vectorize the common case;
+// the offending element is only located once we know there is one.
+inline void check_block(const int64_t* ptr, size_t n, const Range& range, hsize_t offset) {
+    bool bad = false;
+    if (range.has_placeholder) {
+        for (size_t i = 0; i < n; ++i) {
+            auto v = ptr[i];
+            bad |= ((v < range.lower) | (v > range.upper)) & (v != range.placeholder);
+        }
+    } else {
+        for (size_t i = 0; i < n; ++i) {
+            auto v = ptr[i];
+            bad |= (v < range.lower) | (v > range.upper);
+        }
+    }
+    if (!bad) {
+        return;
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        auto v = ptr[i];
+        if ((v < range.lower || v > range.upper) && !(range.has_placeholder && v == range.placeholder)) {
+            throw ValidationError(ErrorCode::INVALID, range.message, offset + i);
+        }
+    }
+}
+
+// Scans an N-dimensional dataset in blocks of consecutive slices along the
+// first (i.e., slowest-changing) dimension, aligned to the chunk boundaries
+// if the dataset is chunked. Blocks are checked in parallel if 'num_threads'
+// is greater than 1 and no I/O service is already active for this thread.
+inline void scan_dataset(const H5::DataSet& handle, const std::vector<hsize_t>& dims, const Range& range, int num_threads, hsize_t buffer_size = 1000000) {
+    if (dims.empty()) {
+        return;
+    }
+
+    hsize_t slice = 1;
+    for (size_t d = 1; d < dims.size(); ++d) {
+        slice *= dims[d];
+    }
+    if (dims[0] == 0 || slice == 0) {
+        return;
+    }
+
+    hsize_t step = internal_io::serialize([&]() -> hsize_t {
+        auto cplist = handle.getCreatePlist();
+        if (cplist.getLayout() != H5D_CHUNKED) {
+            return 1;
+        }
+        std::vector<hsize_t> chunk_dims(dims.size());
+        cplist.getChunk(chunk_dims.size(), chunk_dims.data());
+        return chunk_dims[0];
+    });
+    hsize_t rows = std::max(static_cast<hsize_t>(1), buffer_size / (slice * step)) * step;
+    rows = std::min(rows, dims[0]);
+    hsize_t nblocks = (dims[0] + rows - 1) / rows;
+
+    auto process = [&](hsize_t b) -> void {
+        hsize_t start = b * rows;
+        hsize_t count = std::min(rows, dims[0] - start);
+        std::vector<int64_t> buffer(count * slice);
+
+        internal_io::serialize([&]() -> void {
+            std::vector<hsize_t> hstart(dims.size()), hcount(dims);
+            hstart[0] = start;
+            hcount[0] = count;
+            auto dspace = handle.getSpace();
+            dspace.selectHyperslab(H5S_SELECT_SET, hcount.data(), hstart.data());
+            hsize_t total = buffer.size();
+            H5::DataSpace mspace(1, &total);
+            handle.read(buffer.data(), H5::PredType::NATIVE_INT64, mspace, dspace);
+        });
+
+        check_block(buffer.data(), buffer.size(), range, start * slice);
+    };
+
+    std::exception_ptr error;
+    internal_io::parallelize(nblocks, num_threads, [&](size_t b) -> void {
+        process(b);
+    }, error);
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,270 @@
+#ifndef CHIHAYA_UTILS_COST_HPP
+#define CHIHAYA_UTILS_COST_HPP
+
+#include "H5Cpp.h"
+#include "ritsuko/ritsuko.hpp"
+#include "ritsuko/hdf5/hdf5.hpp"
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+
+#include "utils_public.hpp"
+#include "utils_unary.hpp"
+
+namespace chihaya {
+
+namespace internal_cost {
+
+// Index of the node currently being validated, used to assign parents.
+inline size_t& current_node() {
+    thread_local size_t index = NodeCost::no_parent;
+    return index;
+}
+
+/*
+ * Reserves a slot in 'node_costs' for the node at 'handle', so that nodes are
+ * reported in the order in which they are encountered; this is filled by
+ * fill() once the node has been validated.
+ */
+class NodeScope {
+public:
+    NodeScope(const H5::Group& handle, Options& options) : my_active(options.collect_costs) {
+        if (my_active) {
+            my_index = options.node_costs.size();
+            options.node_costs.emplace_back();
+            auto& current = options.node_costs.back();
+            current.name = handle.getObjName();
+            current.parent = current_node();
+            my_previous = current_node();
+            current_node() = my_index;
+        }
+    }
+
+    ~NodeScope() {
+        if (my_active) {
+            current_node() = my_previous;
+        }
+    }
+
+    NodeScope(const NodeScope&) = delete;
+    NodeScope& operator=(const NodeScope&) = delete;
+
+public:
+    bool active() const {
+        return my_active;
+    }
+
+    size_t index() const {
+        return my_index;
+    }
+
+private:
+    bool my_active;
+    size_t my_index = 0;
+    size_t my_previous = NodeCost::no_parent;
+};
+
+// Groups for lists are part of their node, but groups for arrays and
+// operations are nodes in their own right.
+inline bool is_node(const H5::Group& handle) {
+    if (!handle.attrExists("delayed_type")) {
+        return false;
+    }
+    return ritsuko::hdf5::open_and_load_scalar_string_attribute(handle, "delayed_type") != "list";
+}
+
+inline uint64_t stored_bytes(const H5::Group& handle) {
+    uint64_t total = 0;
+    size_t n = handle.getNumObjs();
+    for (size_t i = 0; i < n; ++i) {
+        auto type = handle.getObjTypeByIdx(i);
+        if (type == H5G_DATASET) {
+            total += handle.openDataSet(handle.getObjnameByIdx(i)).getStorageSize();
+        } else if (type == H5G_GROUP) {
+            auto child = handle.openGroup(handle.getObjnameByIdx(i));
+            if (!is_node(child)) {
+                total += stored_bytes(child);
+            }
+        }
+    }
+    return total;
+}
+
+inline uint64_t element_size(ArrayType type) {
+    switch (type) {
+        case BOOLEAN:
+            return 1;
+        case INTEGER:
+            return 4;
+        default:
+            return 8;
+    }
+}
+
+// Element-wise operations where f(0) = 0, such that a sparse seed remains sparse.
+inline bool preserves_sparsity(const H5::Group& handle, const std::string& kind) {
+    if (kind == "unary arithmetic") {
+        auto method = internal_unary::load_method(handle);
+        auto side = internal_unary::load_side(handle);
+        return side == "none" || method == "*" || (method == "/" && side == "right");
+    } else if (kind == "unary math") {
+        auto method = internal_unary::load_method(handle);
+        return method == "abs" || method == "sign" || method == "sqrt" || method == "log1p" || method == "expm1" ||
+            method == "ceiling" || method == "floor" || method == "trunc" || method == "round" || method == "signif" ||
+            method == "sin" || method == "tan" || method == "asin" || method == "atan" ||
+            method == "sinh" || method == "tanh" || method == "asinh" || method == "atanh";
+    } else if (kind == "unary special check") {
+        auto method = internal_unary::load_method(handle);
+        return method == "is_nan" || method == "is_infinite";
+    }
+    return false;
+}
+
+inline bool ends_with(const std::string& name, const std::string& suffix) {
+    return name.size() >= suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+inline void fill(const H5::Group& handle, const std::string& dtype, const ArrayDetails& details, std::vector<NodeCost>& costs, size_t self) {
+    std::vector<size_t> children;
+    for (size_t i = self + 1, end = costs.size(); i < end; ++i) {
+        if (costs[i].parent == self) {
+            children.push_back(i);
+        }
+    }
+
+    auto& node = costs[self];
+    node.kind = ritsuko::hdf5::open_and_load_scalar_string_attribute(handle, (dtype == "array" ? "delayed_array" : "delayed_operation"));
+    node.details = details;
+    node.stored_bytes = stored_bytes(handle);
+
+    double elements = 1;
+    for (auto d : details.dimensions) {
+        elements *= d;
+    }
+
+    bool all_sparse = !children.empty();
+    double child_nonzeros = 0;
+    double child_elements = 0;
+    for (auto c : children) {
+        all_sparse = all_sparse && costs[c].sparse;
+        child_nonzeros += costs[c].nonzeros;
+        double current = 1;
+        for (auto d : costs[c].details.dimensions) {
+            current *= d;
+        }
+        child_elements += current;
+    }
+
+    const auto& kind = node.kind;
+    bool sparse = false;
+    double nonzeros = elements;
+    double flops = 0;
+
+    if (kind == "sparse matrix") {
+        sparse = true;
+        nonzeros = handle.openDataSet("data").getSpace().getSimpleExtentNpoints();
+
+    } else if (kind == "transpose" || kind == "dimnames" || kind == "combine") {
+        sparse = all_sparse;
+        if (sparse) {
+            nonzeros = child_nonzeros;
+        }
+
+    } else if (kind == "subset") {
+        // Assuming that the non-zeros are evenly distributed throughout the seed.
+        sparse = all_sparse;
+        if (sparse) {
+            nonzeros = (child_elements ? child_nonzeros * elements / child_elements : 0);
+        }
+
+    } else if (kind == "unary arithmetic" || kind == "unary math" || kind == "unary special check") {
+        sparse = all_sparse && preserves_sparsity(handle, kind);
+        if (sparse) {
+            nonzeros = child_nonzeros;
+        }
+        flops = nonzeros;
+
+    } else if (kind == "unary comparison" || kind == "unary logic") {
+        flops = elements;
+
+    } else if (kind == "binary arithmetic" || kind == "binary comparison" || kind == "binary logic") {
+        if (kind == "binary arithmetic" && all_sparse && internal_unary::load_method(handle) == "*") {
+            sparse = true;
+            nonzeros = child_nonzeros;
+            for (auto c : children) {
+                nonzeros = std::min(nonzeros, static_cast<double>(costs[c].nonzeros));
+            }
+        }
+        flops = nonzeros;
+
+    } else if (kind == "matrix product" && details.dimensions.size() == 2) {
+        double nrow = details.dimensions[0], ncol = details.dimensions[1];
+        const NodeCost* left = NULL;
+        const NodeCost* right = NULL;
+        for (auto c : children) {
+            if (ends_with(costs[c].name, "/left_seed")) {
+                left = &costs[c];
+            } else if (ends_with(costs[c].name, "/right_seed")) {
+                right = &costs[c];
+            }
+        }
+
+        if (left && right) {
+            if (left->sparse && right->sparse) {
+                // Row-wise (Gustavson) product of two sparse operands, assuming that
+                // the non-zeros are evenly distributed throughout each operand. The
+                // result is kept sparse rather than densifying either side.
+                double left_elements = 1;
+                for (auto d : left->details.dimensions) {
+                    left_elements *= d;
+                }
+                double common = (nrow ? left_elements / nrow : 0);
+                if (common && elements) {
+                    double left_nnz = left->nonzeros, right_nnz = right->nonzeros;
+                    flops = 2 * left_nnz * right_nnz / common;
+                    double hit = (left_nnz / (nrow * common)) * (right_nnz / (common * ncol));
+                    nonzeros = std::ceil(elements * (1 - std::pow(1 - hit, common)));
+                } else {
+                    nonzeros = 0;
+                }
+                sparse = true;
+            } else if (left->sparse) {
+                flops = 2 * static_cast<double>(left->nonzeros) * ncol;
+            } else if (right->sparse) {
+                flops = 2 * static_cast<double>(right->nonzeros) * nrow;
+            } else {
+                double left_elements = 1;
+                for (auto d : left->details.dimensions) {
+                    left_elements *= d;
+                }
+                flops = 2 * left_elements * ncol; // i.e., 2 * nrow * common * ncol.
+            }
+        }
+    }
+
+    node.sparse = sparse;
+    node.nonzeros = nonzeros;
+    node.flops = flops;
+
+    uint64_t esize = element_size(details.type);
+    if (sparse) {
+        uint64_t primary = (details.dimensions.empty() ? 0 : details.dimensions.back());
+        node.memory_bytes = node.nonzeros * (esize + 8) + (primary + 1) * 8;
+    } else {
+        node.memory_bytes = nonzeros * esize;
+    }
+
+    node.peak_memory_bytes = node.memory_bytes;
+    for (auto c : children) {
+        node.peak_memory_bytes += costs[c].memory_bytes;
+    }
+}
+
+}
+
+}
+
+#endif
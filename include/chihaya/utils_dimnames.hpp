@@ -6,39 +6,69 @@
 #include "ritsuko/ritsuko.hpp"
 #include <string>
 #include <stdexcept>
+#include <vector>
+#include <functional>
+#include <exception>
 #include "utils_list.hpp"
+#include "utils_misc.hpp"
+#include "utils_io.hpp"
+#include "utils_string.hpp"
 
 namespace chihaya {
 
 namespace internal_dimnames {
 
 template<class V>
-void validate(const H5::Group& handle, const V& dimensions, const ritsuko::Version& version) try {
-    if (handle.childObjType("dimnames") != H5O_TYPE_GROUP) {
-        throw std::runtime_error("expected a group at 'dimnames'");
-    }
-    auto ghandle = handle.openGroup("dimnames");
-    auto list_params = internal_list::validate(ghandle, version);
-
-    if (list_params.length != dimensions.size()) {
-        throw std::runtime_error("length of 'dimnames' list should be equal to seed dimensionality");
-    }
+void validate(const H5::Group& handle, const V& dimensions, const ritsuko::Version& version, Options& options) {
+    internal_misc::ContextScope context(options, "failed to validate the '", "dimnames", "'", "");
+    try {
+        if (handle.childObjType("dimnames") != H5O_TYPE_GROUP) {
+            throw std::runtime_error("expected a group at 'dimnames'");
+        }
+        auto ghandle = handle.openGroup("dimnames");
+        auto list_params = internal_list::validate(ghandle, version);
 
-    for (const auto& p : list_params.present) {
-        auto current = ritsuko::hdf5::open_dataset(ghandle, p.second.c_str());
-        if (current.getSpace().getSimpleExtentNdims() != 1 || current.getTypeClass() != H5T_STRING) {
-            throw std::runtime_error("each entry of 'dimnames' should be a 1-dimensional string dataset");
+        if (list_params.length != dimensions.size()) {
+            throw std::runtime_error("length of 'dimnames' list should be equal to seed dimensionality");
         }
 
-        auto len = ritsuko::hdf5::get_1d_length(current, false);
-        if (len != static_cast<hsize_t>(dimensions[p.first])) {
-            throw std::runtime_error("each entry of 'dimnames' should have length equal to the extent of its corresponding dimension");
+        // Scans are either deferred or run in parallel across the entries.
+        std::vector<std::function<void()> > scans;
+
+        for (const auto& p : list_params.present) {
+            auto current = internal_list::open_dataset(ghandle, p);
+            if (current.getSpace().getSimpleExtentNdims() != 1 || current.getTypeClass() != H5T_STRING) {
+                throw std::runtime_error("each entry of 'dimnames' should be a 1-dimensional string dataset");
+            }
+
+            auto len = ritsuko::hdf5::get_1d_length(current, false);
+            if (len != static_cast<hsize_t>(dimensions[p.index])) {
+                throw std::runtime_error("each entry of 'dimnames' should have length equal to the extent of its corresponding dimension");
+            }
+            if (!internal_string::needs_scan(current, options.check_utf8_strings)) {
+                continue;
+            }
+
+            auto scan = [=, check_utf8 = options.check_utf8_strings]() -> void {
+                internal_string::validate_string_dataset(current, std::vector<hsize_t>{ len }, 1000000, check_utf8);
+            };
+            if (options.defer_scans) {
+                internal_misc::scan_or_defer(current, len, options, std::move(scan));
+            } else {
+                scans.push_back(std::move(scan));
+            }
         }
 
-        ritsuko::hdf5::validate_1d_string_dataset(current, len, 1000000);
+        std::exception_ptr error;
+        internal_io::parallelize(scans.size(), options.num_threads, [&](size_t s) -> void {
+            scans[s]();
+        }, error);
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    } catch (std::exception& e) {
+        context.rethrow(e);
     }
-} catch (std::exception& e) {
-    throw std::runtime_error("failed to validate the 'dimnames'; " + std::string(e.what()));
 }
 
 }
@@ -0,0 +1,168 @@
+#ifndef CHIHAYA_UTILS_FILE_HPP
+#define CHIHAYA_UTILS_FILE_HPP
+
+#include "H5Cpp.h"
+
+#include <string>
+#include <filesystem>
+#include <system_error>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+
+#include "utils_public.hpp"
+
+namespace chihaya {
+
+namespace internal_file {
+
+inline void set_metadata_cache(H5::FileAccPropList& fapl, const FileAccessOptions& settings) {
+    if (settings.metadata_cache_size) {
+        H5AC_cache_config_t config;
+        config.version = H5AC__CURR_CACHE_CONFIG_VERSION;
+        H5Pget_mdc_config(fapl.getId(), &config);
+        config.set_initial_size = true;
+        config.initial_size = settings.metadata_cache_size;
+        config.max_size = std::max(config.max_size, config.initial_size);
+        config.min_size = std::min(config.min_size, config.initial_size);
+        H5Pset_mdc_config(fapl.getId(), &config);
+    }
+}
+
+inline H5::FileAccPropList create_access_plist(const FileAccessOptions& settings, bool use_core, bool use_page_buffer) {
+    H5::FileAccPropList fapl;
+    set_metadata_cache(fapl, settings);
+
+    if (use_page_buffer) {
+        H5Pset_page_buffer_size(fapl.getId(), settings.page_buffer_size, 0, 0);
+    }
+
+    if (use_core) {
+        // No backing store is needed as we never write to the file.
+        H5Pset_fapl_core(fapl.getId(), 1024 * 1024, 0);
+    }
+
+    return fapl;
+}
+
+// HDF5 refuses to open a file with a page buffer if the file was not created
+// with the paged file space strategy, or if the buffer is smaller than a page.
+// We check this upfront with a cheap open of the superblock, rather than
+// trying to open the file with a page buffer and catching the failure.
+inline bool supports_page_buffer(const std::string& path, size_t page_buffer_size) {
+    H5::H5File handle(path, H5F_ACC_RDONLY);
+    auto fcpl = handle.getCreatePlist();
+
+    H5F_fspace_strategy_t strategy;
+    hbool_t persist;
+    hsize_t threshold;
+    if (H5Pget_file_space_strategy(fcpl.getId(), &strategy, &persist, &threshold) < 0 || strategy != H5F_FSPACE_STRATEGY_PAGE) {
+        return false;
+    }
+
+    hsize_t page_size;
+    if (H5Pget_file_space_page_size(fcpl.getId(), &page_size) < 0) {
+        return false;
+    }
+    return page_buffer_size >= page_size;
+}
+
+inline H5::H5File open(const std::string& path, const FileAccessOptions& settings) {
+    if (settings.metadata_cache_size == 0 && settings.page_buffer_size == 0 && settings.core_driver_threshold == 0) {
+        return H5::H5File(path, H5F_ACC_RDONLY);
+    }
+
+    bool use_core = false;
+    if (settings.core_driver_threshold) {
+        std::error_code ec;
+        auto size = std::filesystem::file_size(path, ec);
+        use_core = (!ec && size <= settings.core_driver_threshold);
+    }
+
+    bool use_page_buffer = (settings.page_buffer_size && supports_page_buffer(path, settings.page_buffer_size));
+    return H5::H5File(path, H5F_ACC_RDONLY, H5::FileCreatPropList::DEFAULT, create_access_plist(settings, use_core, use_page_buffer));
+}
+
+/*
+ * Callbacks for the core driver to use the caller's buffer directly, instead
+ * of copying it into the property list and again into the opened file. This
+ * is safe as the file is opened read-only, so the image is never modified or
+ * resized; we only need to make sure that HDF5 never frees the buffer.
+ */
+struct ImageBuffer {
+    const void* data;
+    size_t size;
+};
+
+inline void* image_malloc(size_t size, H5FD_file_image_op_t, void* udata) {
+    auto ptr = static_cast<ImageBuffer*>(udata);
+    if (size != ptr->size) {
+        return NULL;
+    }
+    return const_cast<void*>(ptr->data);
+}
+
+inline void* image_memcpy(void* dest, const void* src, size_t size, H5FD_file_image_op_t, void*) {
+    if (dest != src) {
+        std::memcpy(dest, src, size);
+    }
+    return dest;
+}
+
+inline void* image_realloc(void*, size_t, H5FD_file_image_op_t, void*) {
+    return NULL;
+}
+
+inline herr_t image_free(void*, H5FD_file_image_op_t, void*) {
+    return 0;
+}
+
+inline void* image_udata_copy(void* udata) {
+    return udata;
+}
+
+inline herr_t image_udata_free(void*) {
+    return 0;
+}
+
+inline constexpr const char* image_name_prefix = "chihaya_file_image_";
+
+// File images have no location on disk, so anything that needs the directory
+// of the file (e.g., to resolve relative paths) should check this first.
+inline bool is_image(const std::string& name) {
+    return name.rfind(image_name_prefix, 0) == 0;
+}
+
+inline H5::H5File open(const void* data, size_t size, const FileAccessOptions& settings, ImageBuffer& image) {
+    image.data = data;
+    image.size = size;
+
+    H5::FileAccPropList fapl;
+    set_metadata_cache(fapl, settings);
+    H5Pset_fapl_core(fapl.getId(), 1024 * 1024, 0);
+
+    H5FD_file_image_callbacks_t callbacks;
+    callbacks.image_malloc = image_malloc;
+    callbacks.image_memcpy = image_memcpy;
+    callbacks.image_realloc = image_realloc;
+    callbacks.image_free = image_free;
+    callbacks.udata_copy = image_udata_copy;
+    callbacks.udata_free = image_udata_free;
+    callbacks.udata = &image;
+    if (H5Pset_file_image_callbacks(fapl.getId(), &callbacks) < 0 || H5Pset_file_image(fapl.getId(), const_cast<void*>(data), size) < 0) {
+        throw std::runtime_error("failed to set the file image");
+    }
+
+    // Each image needs a unique name, otherwise HDF5 will consider them to be
+    // the same file if multiple images are open at the same time.
+    static std::atomic<size_t> counter(0);
+    std::string name = image_name_prefix + std::to_string(counter++);
+    return H5::H5File(name, H5F_ACC_RDONLY, H5::FileCreatPropList::DEFAULT, fapl);
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,233 @@
+#ifndef CHIHAYA_UTILS_IO_HPP
+#define CHIHAYA_UTILS_IO_HPP
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <deque>
+#include <utility>
+#include <type_traits>
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <exception>
+#include <algorithm>
+
+namespace chihaya {
+
+namespace internal_io {
+
+/*
+ * Dedicated I/O thread that executes all HDF5 calls on behalf of other
+ * threads. As HDF5 is not thread-safe, this allows CPU-bound work (e.g., index
+ * checks) to be parallelized while the HDF5 calls themselves are serialized.
+ * Requests are arbitrary callables, typically a read of a hyperslab into a
+ * buffer owned by the submitting thread.
+ */
+class Service {
+public:
+    Service() : my_thread([&]() -> void { loop(); }) {}
+
+    ~Service() {
+        {
+            std::lock_guard<std::mutex> lck(my_mut);
+            my_finished = true;
+        }
+        my_cv.notify_all();
+        my_thread.join();
+    }
+
+    Service(const Service&) = delete;
+    Service& operator=(const Service&) = delete;
+
+public:
+    // Queue a request and return immediately; the future will re-throw any
+    // errors from the request when get() is called.
+    template<class Function_>
+    std::future<typename std::invoke_result<Function_>::type> submit(Function_ fun) {
+        std::packaged_task<typename std::invoke_result<Function_>::type()> task(std::move(fun));
+        auto output = task.get_future();
+        {
+            std::lock_guard<std::mutex> lck(my_mut);
+            my_queue.emplace_back(std::move(task));
+        }
+        my_cv.notify_all();
+        return output;
+    }
+
+    // Queue a request and wait for its completion.
+    template<class Function_>
+    typename std::invoke_result<Function_>::type run(Function_ fun) {
+        return submit(std::move(fun)).get();
+    }
+
+private:
+    std::mutex my_mut;
+    std::condition_variable my_cv;
+    std::deque<std::packaged_task<void()> > my_queue;
+    bool my_finished = false;
+    std::thread my_thread; // declared last so that it starts after everything else is constructed.
+
+    void loop() {
+        while (true) {
+            std::packaged_task<void()> task;
+            {
+                std::unique_lock<std::mutex> lck(my_mut);
+                my_cv.wait(lck, [&]() -> bool { return my_finished || !my_queue.empty(); });
+                if (my_queue.empty()) {
+                    return;
+                }
+                task = std::move(my_queue.front());
+                my_queue.pop_front();
+            }
+            task();
+        }
+    }
+};
+
+// Service that is responsible for the HDF5 calls in the current thread, if any.
+inline Service*& current_service() {
+    thread_local Service* ptr = NULL;
+    return ptr;
+}
+
+// Makes 'service' responsible for the HDF5 calls in the current thread until
+// the end of the enclosing scope.
+class ServiceScope {
+public:
+    ServiceScope(Service& service) : my_previous(current_service()) {
+        current_service() = &service;
+    }
+
+    ~ServiceScope() {
+        current_service() = my_previous;
+    }
+
+    ServiceScope(const ServiceScope&) = delete;
+    ServiceScope& operator=(const ServiceScope&) = delete;
+
+private:
+    Service* my_previous;
+};
+
+// Run 'fun' with an active service for the current thread, creating a
+// dedicated service if none is already active. This is necessary when
+// multiple streams are consumed at once, to avoid concurrent HDF5 calls
+// from each stream's own I/O thread.
+template<class Function_>
+void with_service(Function_ fun) {
+    if (current_service()) {
+        fun();
+    } else {
+        Service dedicated;
+        ServiceScope scope(dedicated);
+        fun();
+    }
+}
+
+// Calls 'fun' on each index in [0, n), using up to 'num_threads' worker
+// threads that share a single service for their HDF5 calls. Indices are
+// processed sequentially if a service is already active for this thread.
+// If any call fails, no further indices are started; the exception from the
+// smallest failing index is stored in 'error' and that index is returned.
+// Otherwise, 'n' is returned.
+template<class Function_>
+size_t parallelize(size_t n, int num_threads, Function_ fun, std::exception_ptr& error) {
+    size_t failed = n;
+
+    if (num_threads <= 1 || n <= 1 || current_service()) {
+        for (size_t i = 0; i < n; ++i) {
+            try {
+                fun(i);
+            } catch (...) {
+                failed = i;
+                error = std::current_exception();
+                break;
+            }
+        }
+        return failed;
+    }
+
+    Service service;
+    std::atomic<size_t> counter(0);
+    std::mutex error_lock;
+    size_t nthreads = std::min(n, static_cast<size_t>(num_threads));
+
+    std::vector<std::thread> workers;
+    workers.reserve(nthreads);
+    for (size_t t = 0; t < nthreads; ++t) {
+        workers.emplace_back([&]() -> void {
+            ServiceScope scope(service);
+            while (true) {
+                size_t i = counter.fetch_add(1);
+                if (i >= n) {
+                    break;
+                }
+                try {
+                    fun(i);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lck(error_lock);
+                    if (i < failed) {
+                        failed = i;
+                        error = std::current_exception();
+                    }
+                    counter = n; // no need to start any more.
+                }
+            }
+        });
+    }
+
+    for (auto& w : workers) {
+        w.join();
+    }
+    return failed;
+}
+
+// Run 'fun' on the current thread's service if one is active, otherwise
+// call it directly. All HDF5 calls inside deferred scans should use this.
+template<class Function_>
+typename std::invoke_result<Function_>::type serialize(Function_ fun) {
+    auto ptr = current_service();
+    if (ptr) {
+        return ptr->run(std::move(fun));
+    } else {
+        return fun();
+    }
+}
+
+// Holds a HDF5 object that is created and destroyed via serialize(), as the
+// destructors of HDF5's C++ classes also call into the library.
+template<class Object_>
+class SerializedObject {
+public:
+    template<class Function_>
+    SerializedObject(Function_ create) {
+        serialize([&]() -> void {
+            my_object.reset(new Object_(create()));
+        });
+    }
+
+    ~SerializedObject() {
+        serialize([&]() -> void {
+            my_object.reset();
+        });
+    }
+
+    SerializedObject(const SerializedObject&) = delete;
+    SerializedObject& operator=(const SerializedObject&) = delete;
+
+public:
+    const Object_& operator*() const {
+        return *my_object;
+    }
+
+private:
+    std::unique_ptr<Object_> my_object;
+};
+
+}
+
+}
+
+#endif
@@ -1,9 +1,12 @@
 #ifndef CHIHAYA_UTILS_LIST_HPP
 #define CHIHAYA_UTILS_LIST_HPP
 
-#include <map>
+#include <vector>
 #include <string>
 #include <stdexcept>
+#include <algorithm>
+#include <limits>
+#include <utility>
 
 #include "H5Cpp.h"
 #include "ritsuko/ritsuko.hpp"
@@ -15,11 +18,94 @@ namespace chihaya {
 
 namespace internal_list {
 
+struct ListElement {
+    size_t index;
+
+    // Hard links are opened directly from the object header location, other
+    // link types fall back to the link's position in the name index.
+    bool hard;
+#if H5_VERSION_GE(1, 12, 0)
+    H5O_token_t location;
+#else
+    haddr_t location;
+#endif
+    hsize_t link;
+
+    // Actual name of the link, which may differ from the canonical name of
+    // 'index' in non-conforming files, e.g., "01".
+    std::string name;
+};
+
 struct ListDetails {
     size_t length;
-    std::map<size_t, std::string> present;
+
+    // Sorted by 'index', so for a complete list, 'present[i].index == i'.
+    std::vector<ListElement> present;
 };
 
+struct ListIteration {
+    size_t length;
+    hsize_t link = 0;
+    std::vector<ListElement>* present;
+    bool failed = false;
+    std::string failed_name; // only filled on failure, as 'name' does not outlive the callback.
+    bool out_of_range = false;
+};
+
+#if H5_VERSION_GE(1, 12, 0)
+inline herr_t list_iteration_callback(hid_t, const char* name, const H5L_info2_t* info, void* data) {
+#else
+inline herr_t list_iteration_callback(hid_t, const char* name, const H5L_info_t* info, void* data) {
+#endif
+    auto& iter = *static_cast<ListIteration*>(data);
+    hsize_t link = iter.link;
+    ++iter.link;
+
+    // Aaron's cheap and dirty atoi, without copying the name. We stop
+    // accumulating once the index is out of range, to avoid overflow.
+    size_t sofar = 0;
+    bool out_of_range = false;
+    for (const char* ptr = name; *ptr != '\0'; ++ptr) {
+        char c = *ptr;
+        if (c < '0' || c > '9') {
+            iter.failed = true;
+            iter.failed_name = name;
+            return 1; // positive values stop the iteration without raising a HDF5 error.
+        }
+        if (!out_of_range) {
+            size_t digit = c - '0';
+            if (sofar > (std::numeric_limits<size_t>::max() - digit) / 10) {
+                out_of_range = true;
+            } else {
+                sofar = sofar * 10 + digit;
+                out_of_range = (sofar >= iter.length);
+            }
+        }
+    }
+
+    if (out_of_range) {
+        iter.failed = true;
+        iter.out_of_range = true;
+        iter.failed_name = name;
+        return 1;
+    }
+
+    ListElement current{};
+    current.index = sofar;
+    current.hard = (info->type == H5L_TYPE_HARD);
+    if (current.hard) {
+#if H5_VERSION_GE(1, 12, 0)
+        current.location = info->u.token;
+#else
+        current.location = info->u.address;
+#endif
+    }
+    current.link = link;
+    current.name = name;
+    iter.present->push_back(std::move(current));
+    return 0;
+}
+
 inline ListDetails validate(const H5::Group& handle, const ritsuko::Version& version) {
     ListDetails output;
 
@@ -61,25 +147,78 @@ inline ListDetails validate(const H5::Group& handle, const ritsuko::Version& ver
     if (n > output.length) {
         throw std::runtime_error("more objects in the list than are specified by '" + std::string(actual_name) + "'");
     }
-    for (size_t i = 0; i < n; ++i) {
-        std::string name = handle.getObjnameByIdx(i);
-
-        // Aaron's cheap and dirty atoi!
-        int sofar = 0;
-        for (auto c : name) {
-            if (c < '0' || c > '9') {
-                throw std::runtime_error("'" + name + "' is not a valid name for a list index");
-            }
-            sofar *= 10;
-            sofar += (c - '0'); 
-        }
 
-        if (static_cast<size_t>(sofar) >= output.length) {
+    // Collecting all links in a single pass, rather than looking up each name
+    // in the group's B-tree; this matters for lists with many elements.
+    output.present.reserve(n);
+    ListIteration iter;
+    iter.length = output.length;
+    iter.present = &(output.present);
+
+#if H5_VERSION_GE(1, 12, 0)
+    herr_t status = H5Literate2(handle.getId(), H5_INDEX_NAME, H5_ITER_INC, NULL, list_iteration_callback, &iter);
+#else
+    herr_t status = H5Literate(handle.getId(), H5_INDEX_NAME, H5_ITER_INC, NULL, list_iteration_callback, &iter);
+#endif
+    if (iter.failed) {
+        const auto& name = iter.failed_name;
+        if (iter.out_of_range) {
             throw std::runtime_error("'" + name + "' is out of range for a list"); 
+        } else {
+            throw std::runtime_error("'" + name + "' is not a valid name for a list index");
         }
-        output.present[sofar] = name;
     }
+    if (status < 0) {
+        throw std::runtime_error("failed to iterate over the list elements");
+    }
+
+    // Names are ordered lexicographically by HDF5, so we need to sort by index.
+    std::sort(output.present.begin(), output.present.end(), [](const ListElement& left, const ListElement& right) -> bool { return left.index < right.index; });
+    for (size_t i = 1, end = output.present.size(); i < end; ++i) {
+        if (output.present[i].index == output.present[i - 1].index) {
+            throw std::runtime_error("multiple objects for index " + std::to_string(output.present[i].index) + " in the list");
+        }
+    }
+
+    return output;
+}
 
+inline hid_t open_element(const H5::Group& handle, const ListElement& element) {
+    hid_t oid;
+    if (element.hard) {
+#if H5_VERSION_GE(1, 12, 0)
+        oid = H5Oopen_by_token(handle.getId(), element.location);
+#else
+        oid = H5Oopen_by_addr(handle.getId(), element.location);
+#endif
+    } else {
+        oid = H5Oopen_by_idx(handle.getId(), ".", H5_INDEX_NAME, H5_ITER_INC, element.link, H5P_DEFAULT);
+    }
+    if (oid < 0) {
+        throw std::runtime_error("failed to open the list element at index " + std::to_string(element.index));
+    }
+    return oid;
+}
+
+inline H5::Group open_group(const H5::Group& handle, const ListElement& element) {
+    hid_t oid = open_element(handle, element);
+    if (H5Iget_type(oid) != H5I_GROUP) {
+        H5Oclose(oid);
+        throw std::runtime_error("expected a group at '" + std::to_string(element.index) + "'");
+    }
+    H5::Group output(oid); // increments the reference count.
+    H5Oclose(oid);
+    return output;
+}
+
+inline H5::DataSet open_dataset(const H5::Group& handle, const ListElement& element) {
+    hid_t oid = open_element(handle, element);
+    if (H5Iget_type(oid) != H5I_DATASET) {
+        H5Oclose(oid);
+        throw std::runtime_error("expected a dataset at '" + std::to_string(element.index) + "'");
+    }
+    H5::DataSet output(oid); // increments the reference count.
+    H5Oclose(oid);
     return output;
 }
 
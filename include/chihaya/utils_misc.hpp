@@ -7,6 +7,10 @@
 
 #include <string>
 #include <stdexcept>
+#include <vector>
+#include <cstdint>
+
+#include "utils_public.hpp"
 
 namespace chihaya {
 
@@ -14,6 +18,87 @@ ArrayDetails validate(const H5::Group&, const ritsuko::Version&, Options&);
 
 namespace internal_misc {
 
+// Must be called inside a catch block, where 'e' is the caught exception.
+// Existing ValidationErrors are re-thrown with the extra context, avoiding a
+// fresh concatenation of the message at every level of the tree. The
+// description is 'prefix + subject + suffix' and is only assembled if the
+// full message is requested; 'prefix' and 'suffix' should be literals.
+[[noreturn]] inline void rethrow_with_context(std::exception& e, const char* prefix, std::string subject, const char* suffix, std::string child = "") {
+    auto vptr = dynamic_cast<ValidationError*>(&e);
+    if (vptr) {
+        vptr->add_context(prefix, std::move(subject), suffix, std::move(child));
+        throw;
+    }
+
+    ValidationError err(ErrorCode::INVALID, e.what());
+    err.add_context(prefix, std::move(subject), suffix, std::move(child));
+    throw err;
+}
+
+// Same as above, for descriptions that are literals.
+[[noreturn]] inline void rethrow_with_context(std::exception& e, const char* description, std::string child = "") {
+    rethrow_with_context(e, description, std::string(), "", std::move(child));
+}
+
+// Context for errors raised while validating a child or the contents of a
+// node. The description is 'prefix + subject + suffix', and if 'child_prefix'
+// is not NULL, the error occurred in the child 'child_prefix + subject'.
+struct Context {
+    const char* prefix;
+    std::string subject;
+    const char* suffix;
+    const char* child_prefix;
+
+    std::string child() const {
+        return (child_prefix ? child_prefix + subject : std::string());
+    }
+};
+
+// Contexts that enclose the current point of the traversal, outermost first.
+// Only populated if scans are deferred, see ContextScope.
+inline std::vector<const Context*>& enclosing_contexts() {
+    thread_local std::vector<const Context*> stack;
+    return stack;
+}
+
+/*
+ * Catch blocks that add context to errors from child nodes or scans should do
+ * so via this class, i.e., by calling rethrow() on a ContextScope created
+ * before the corresponding try block. If scans are deferred, the scope also
+ * records its context so that errors from the deferred scans are given the
+ * same context as if they had been raised during the traversal.
+ */
+class ContextScope {
+public:
+    ContextScope(const Options& options, const char* prefix, std::string subject, const char* suffix, const char* child_prefix = NULL) :
+        my_context{ prefix, std::move(subject), suffix, child_prefix },
+        my_recorded(options.defer_scans)
+    {
+        if (my_recorded) {
+            enclosing_contexts().push_back(&my_context);
+        }
+    }
+
+    ~ContextScope() {
+        if (my_recorded) {
+            enclosing_contexts().pop_back();
+        }
+    }
+
+    ContextScope(const ContextScope&) = delete;
+    ContextScope& operator=(const ContextScope&) = delete;
+
+public:
+    // Must be called inside a catch block, see rethrow_with_context().
+    [[noreturn]] void rethrow(std::exception& e) const {
+        rethrow_with_context(e, my_context.prefix, my_context.subject, my_context.suffix, my_context.child());
+    }
+
+private:
+    Context my_context;
+    bool my_recorded;
+};
+
 template<class V>
 bool are_dimensions_equal(const V& left, const V& right) {
     if (left.size() != right.size()) {
@@ -46,6 +131,57 @@ inline void validate_missing_placeholder(const H5::DataSet& handle, const ritsuk
     }
 }
 
+// Expensive scans of dataset contents should go through this function, so
+// that they can be deferred until all cheap checks have been performed.
+// Deferred scans add the context of the enclosing catch blocks to their
+// errors, so that the error is the same as that from an immediate scan.
+template<class Function_>
+void scan_or_defer(const H5::DataSet& handle, size_t size, Options& options, Function_ scan) {
+    if (options.defer_scans) {
+        std::vector<Context> contexts;
+        for (auto ptr : enclosing_contexts()) {
+            contexts.push_back(*ptr);
+        }
+
+        DeferredScan deferred;
+        deferred.name = handle.getObjName();
+        deferred.size = size;
+        deferred.run = [scan = std::move(scan), contexts = std::move(contexts)]() -> void {
+            try {
+                scan();
+            } catch (std::exception& e) {
+                auto vptr = dynamic_cast<ValidationError*>(&e);
+                ValidationError err = (vptr ? std::move(*vptr) : ValidationError(ErrorCode::INVALID, e.what()));
+                for (auto it = contexts.rbegin(); it != contexts.rend(); ++it) {
+                    err.add_context(it->prefix, it->subject, it->suffix, it->child());
+                }
+                throw err;
+            }
+        };
+        options.deferred_scans.push_back(std::move(deferred));
+    } else {
+        scan();
+    }
+}
+
+// Calls 'fun' with a value-initialized instance of the smallest native
+// unsigned type that can hold the stored datatype of 'handle'. This allows
+// index datasets to be streamed without widening every value to 64 bits.
+// Assumes that the datatype fits in a 64-bit unsigned integer.
+template<class Function_>
+void visit_unsigned_index_type(const H5::DataSet& handle, Function_ fun) {
+    auto precision = handle.getIntType().getPrecision();
+    if (precision <= 8) {
+        fun(static_cast<uint8_t>(0));
+    } else if (precision <= 16) {
+        fun(static_cast<uint16_t>(0));
+    } else if (precision <= 32) {
+        fun(static_cast<uint32_t>(0));
+    } else {
+        fun(static_cast<uint64_t>(0));
+    }
+}
+
 inline uint64_t load_along(const H5::Group& handle, const ritsuko::Version& version) {
     auto ahandle = ritsuko::hdf5::open_dataset(handle, "along");
     if (!ritsuko::hdf5::is_scalar(ahandle)) {
@@ -74,10 +210,11 @@ inline uint64_t load_along(const H5::Group& handle, const ritsuko::Version& vers
 inline ArrayDetails load_seed_details(const H5::Group& handle, const std::string& name, const ritsuko::Version& version, Options& options) {
     ArrayDetails output;
     auto shandle = ritsuko::hdf5::open_group(handle, name.c_str());
+    ContextScope context(options, "failed to validate '", name, "'", "");
     try {
         output = ::chihaya::validate(shandle, version, options);
     } catch (std::exception& e) {
-        throw std::runtime_error("failed to validate '" + name + "'; " + std::string(e.what()));
+        context.rethrow(e);
     }
     return output;
 }
@@ -8,6 +8,11 @@
 #include <functional>
 #include <vector>
 #include <unordered_map>
+#include <list>
+#include <exception>
+#include <stdexcept>
+#include <limits>
+#include <cstdint>
 
 /**
  * @file utils_public.hpp
@@ -56,6 +61,445 @@ struct ArrayDetails {
     std::vector<size_t> dimensions;
 };
 
+/**
+ * Category of a validation failure, see `ValidationError`.
+ */
+enum class ErrorCode : uint8_t {
+    NONE = 0, /**< No error. */
+    INVALID = 1, /**< Generic violation of the specification, e.g., missing or malformed datasets, inconsistent dimensions. */
+    UNKNOWN_TYPE = 2, /**< Unknown delayed type, array type or operation type. */
+    INVALID_INDEX = 3, /**< Invalid entry in a scanned index dataset, e.g., out of range or unsorted. */
+    HDF5_ERROR = 4 /**< Error raised by the HDF5 library itself. */
+};
+
+/**
+ * @brief Error from a failed validation.
+ *
+ * This records the innermost error message along with the context from each enclosing node of the delayed object.
+ * The context descriptions are stored as pieces and the full human-readable message is only assembled when `what()` is called,
+ * so applications that only need the error code or path can avoid the cost of string concatenation at every level of the tree.
+ * This derives from `std::runtime_error` so that existing handlers for the errors thrown by `validate()` will continue to match.
+ */
+class ValidationError : public std::runtime_error {
+public:
+    /**
+     * @param code Category of the error.
+     * @param message Innermost error message.
+     * @param index Position of the offending element in a scanned dataset, if applicable.
+     */
+    ValidationError(ErrorCode code, std::string message, size_t index = no_index) : std::runtime_error(message), my_code(code), my_message(std::move(message)), my_index(index) {}
+
+    /**
+     * Default constructor, corresponding to no error.
+     */
+    ValidationError() : std::runtime_error("") {}
+
+    /**
+     * Placeholder value for `index()` when no element is associated with the error.
+     */
+    static constexpr size_t no_index = std::numeric_limits<size_t>::max();
+
+public:
+    /**
+     * @return Category of the error.
+     */
+    ErrorCode code() const {
+        return my_code;
+    }
+
+    /**
+     * @return Position of the offending element in the scanned dataset, or `no_index` if not applicable.
+     */
+    size_t index() const {
+        return my_index;
+    }
+
+    /**
+     * @return Names of the child objects leading from the validated group to the location of the error, from outermost to innermost.
+     */
+    std::vector<std::string> path() const {
+        std::vector<std::string> output;
+        for (auto it = my_context.rbegin(); it != my_context.rend(); ++it) {
+            if (!it->child.empty()) {
+                output.push_back(it->child);
+            }
+        }
+        return output;
+    }
+
+    /**
+     * @return Full error message, including the context from each enclosing node.
+     */
+    const char* what() const noexcept override {
+        if (my_rendered.empty()) {
+            for (auto it = my_context.rbegin(); it != my_context.rend(); ++it) {
+                my_rendered += it->prefix;
+                my_rendered += it->subject;
+                my_rendered += it->suffix;
+                my_rendered += "; ";
+            }
+            my_rendered += my_message;
+        }
+        return my_rendered.c_str();
+    }
+
+    /**
+     * Add context for an enclosing node. 
+     * This should be called by the enclosing node's validation function before re-throwing the error.
+     *
+     * @param description Description of the enclosing context, to be prepended to the message.
+     * @param child Name of the child object (relative to the enclosing node) in which the error occurred.
+     * This may be empty if the context does not correspond to a child object.
+     */
+    void add_context(std::string description, std::string child = "") {
+        add_context("", std::move(description), "", std::move(child));
+    }
+
+    /**
+     * Add context for an enclosing node, where the description is only concatenated when `what()` is called.
+     * The description is defined as `prefix`, followed by `subject`, followed by `suffix`.
+     *
+     * @param prefix Start of the description.
+     * This should be a string literal or otherwise outlive the `ValidationError`.
+     * @param subject Variable part of the description, e.g., the name of a child or the type of the enclosing node.
+     * @param suffix End of the description.
+     * This should be a string literal or otherwise outlive the `ValidationError`.
+     * @param child Name of the child object (relative to the enclosing node) in which the error occurred.
+     * This may be empty if the context does not correspond to a child object.
+     */
+    void add_context(const char* prefix, std::string subject, const char* suffix, std::string child = "") {
+        my_context.push_back(Context{ std::move(child), prefix, std::move(subject), suffix });
+        my_rendered.clear();
+    }
+
+private:
+    ErrorCode my_code = ErrorCode::NONE;
+    std::string my_message;
+    size_t my_index = no_index;
+
+    struct Context {
+        std::string child;
+        const char* prefix;
+        std::string subject;
+        const char* suffix;
+    };
+    std::vector<Context> my_context; // innermost first.
+    mutable std::string my_rendered;
+};
+
+/**
+ * @brief Status of a validation.
+ *
+ * This is returned by `try_validate()`, which catches the error thrown by `validate()` and stores it here.
+ */
+struct ValidationStatus {
+    /**
+     * Details of the array, only meaningful if `valid()` is true.
+     */
+    ArrayDetails details;
+
+    /**
+     * Error from the validation.
+     * This has an error code of `ErrorCode::NONE` if the validation was successful.
+     * The human-readable message is only assembled upon calling `ValidationError::what()`.
+     */
+    ValidationError error;
+
+    /**
+     * @return Whether the validation was successful.
+     */
+    bool valid() const {
+        return error.code() == ErrorCode::NONE;
+    }
+};
+
+/**
+ * @brief Deferred scan of a dataset's contents.
+ */
+struct DeferredScan {
+    /**
+     * Full name of the dataset to be scanned.
+     * Errors from `run` do not include this name; they have the same context as if the scan had not been deferred.
+     */
+    std::string name;
+
+    /**
+     * Number of elements in the dataset, as a proxy for the cost of the scan.
+     */
+    size_t size = 0;
+
+    /**
+     * Function to perform the scan.
+     * This should throw an error if the dataset contents are invalid.
+     */
+    std::function<void()> run;
+};
+
+/**
+ * @brief Statistics for a sparse matrix.
+ *
+ * These are computed in the same pass as the validation of the sparse matrix's indices, see `Options::collect_sparse_statistics`.
+ */
+struct SparseStatistics {
+    /**
+     * Full name of the HDF5 group containing the sparse matrix.
+     */
+    std::string name;
+
+    /**
+     * Number of structural non-zero elements in each row.
+     */
+    std::vector<uint64_t> row_nonzeros;
+
+    /**
+     * Number of structural non-zero elements in each column.
+     */
+    std::vector<uint64_t> column_nonzeros;
+
+    /**
+     * Sum of the non-missing values in each row.
+     * Missing values (i.e., NaNs or values equal to the missing placeholder) are treated as zero.
+     * Together with the row extents and `row_sums_of_squares`, this can be used to compute the mean and variance of each row without realizing the matrix.
+     */
+    std::vector<double> row_sums;
+
+    /**
+     * Sum of the non-missing values in each column, see `row_sums` for details.
+     */
+    std::vector<double> column_sums;
+
+    /**
+     * Sum of the squares of the non-missing values in each row, see `row_sums` for details.
+     */
+    std::vector<double> row_sums_of_squares;
+
+    /**
+     * Sum of the squares of the non-missing values in each column, see `row_sums` for details.
+     */
+    std::vector<double> column_sums_of_squares;
+
+    /**
+     * Minimum of the non-missing values in `data`.
+     * This is positive infinity if there are no non-missing values.
+     */
+    double minimum = std::numeric_limits<double>::infinity();
+
+    /**
+     * Maximum of the non-missing values in `data`.
+     * This is negative infinity if there are no non-missing values.
+     */
+    double maximum = -std::numeric_limits<double>::infinity();
+
+    /**
+     * Number of NaN values in `data`, excluding those that are treated as missing.
+     */
+    uint64_t nan_count = 0;
+
+    /**
+     * Number of values in `data` that are equal to the missing placeholder.
+     * If the placeholder is NaN, all NaN values are counted here instead of in `nan_count`.
+     */
+    uint64_t placeholder_count = 0;
+};
+
+/**
+ * @brief Cost estimates for a node of a delayed object.
+ *
+ * These are collected during validation if `Options::collect_costs = true`, see `estimate_cost()` for details.
+ * All estimates refer to the realization of the node's result from the results of its children.
+ */
+struct NodeCost {
+    /**
+     * Full name of the HDF5 group for this node.
+     */
+    std::string name;
+
+    /**
+     * Type of the array or operation, i.e., the `delayed_array` or `delayed_operation` attribute.
+     */
+    std::string kind;
+
+    /**
+     * Index of the parent node in `Options::node_costs`, or `no_parent` for the root.
+     */
+    size_t parent = no_parent;
+
+    /**
+     * Placeholder value for `parent` when the node has no parent.
+     */
+    static constexpr size_t no_parent = std::numeric_limits<size_t>::max();
+
+    /**
+     * Details of the node's result.
+     */
+    ArrayDetails details;
+
+    /**
+     * Number of bytes used to store this node's own datasets in the file, excluding those of its children.
+     * This is a proxy for the number of bytes that need to be read from disk.
+     */
+    uint64_t stored_bytes = 0;
+
+    /**
+     * Whether the node's result is expected to be sparse.
+     */
+    bool sparse = false;
+
+    /**
+     * Estimated number of structural non-zero elements in the node's result if `sparse = true`, otherwise the total number of elements.
+     */
+    uint64_t nonzeros = 0;
+
+    /**
+     * Estimated number of floating-point operations to compute the node's result.
+     * This is zero for nodes that only rearrange their inputs, e.g., subsetting, combining or transposition.
+     */
+    double flops = 0;
+
+    /**
+     * Estimated size of the node's result in memory, in bytes.
+     * Sparse results are assumed to use a compressed sparse layout with 64-bit indices,
+     * and string results are assumed to use one pointer per element, ignoring the size of the strings themselves.
+     */
+    uint64_t memory_bytes = 0;
+
+    /**
+     * Estimated peak memory usage to compute the node's result, i.e., the size of the result plus the sizes of its inputs.
+     */
+    uint64_t peak_memory_bytes = 0;
+};
+
+/**
+ * @brief File access settings.
+ *
+ * These are used when the `validate()` and `try_validate()` overloads open a HDF5 file from its path.
+ * Validation of delayed objects with deep trees is typically dominated by metadata I/O for many small groups and attributes,
+ * so tuning the metadata cache and page buffer can be more effective than any optimization of the data reads.
+ * All settings default to HDF5's own defaults.
+ */
+struct FileAccessOptions {
+    /**
+     * Size of the metadata cache in bytes.
+     * If non-zero, this is used as the initial size of the cache, and the maximum size is increased to match if necessary.
+     * Larger caches avoid evicting the headers of groups that are revisited, e.g., for lists with many elements.
+     */
+    size_t metadata_cache_size = 0;
+
+    /**
+     * Size of the page buffer in bytes.
+     * If non-zero, metadata and raw data are cached in pages, which reduces the number of small reads.
+     * This is only supported by HDF5 for files that were created with the paged file space strategy and for buffers that can hold at least one page;
+     * otherwise, it is ignored.
+     * Checking whether a file is paged requires an extra open of the file, which is only performed if this is non-zero.
+     */
+    size_t page_buffer_size = 0;
+
+    /**
+     * Maximum size of a file in bytes for it to be loaded into memory with the `core` driver.
+     * If a file is no larger than this threshold, it is read from disk in a single pass when it is opened,
+     * such that all subsequent metadata accesses are served from memory.
+     * If zero, the `core` driver is never used.
+     */
+    size_t core_driver_threshold = 0;
+};
+
+/**
+ * @brief Pool of open HDF5 files.
+ *
+ * This is used to resolve external HDF5 arrays, see `Options::resolve_external_hdf5`.
+ * Files are kept open so that many external arrays referring to the same file do not need to reopen it each time.
+ * Once the pool is full, the least recently used file is closed to make room for a new file.
+ */
+class ExternalFilePool {
+public:
+    /**
+     * @param capacity Maximum number of files to keep open.
+     */
+    ExternalFilePool(size_t capacity = 16) : my_capacity(capacity) {}
+
+    /**
+     * @cond
+     */
+    // The index holds iterators into the list, so it must be rebuilt to point
+    // into our own list after copying; moving a list preserves its iterators.
+    ExternalFilePool(const ExternalFilePool& other) : my_capacity(other.my_capacity), my_files(other.my_files) {
+        reindex();
+    }
+
+    ExternalFilePool& operator=(const ExternalFilePool& other) {
+        if (this != &other) {
+            auto files = other.my_files;
+            my_capacity = other.my_capacity;
+            my_files.swap(files);
+            reindex();
+        }
+        return *this;
+    }
+
+    ExternalFilePool(ExternalFilePool&&) = default;
+
+    ExternalFilePool& operator=(ExternalFilePool&&) = default;
+
+    ~ExternalFilePool() = default;
+    /**
+     * @endcond
+     */
+
+public:
+    /**
+     * @param path Path to a HDF5 file.
+     * @return Handle to the file, opened in read-only mode.
+     * This is retrieved from the pool if the file is already open.
+     */
+    H5::H5File open(const std::string& path) {
+        auto it = my_index.find(path);
+        if (it != my_index.end()) {
+            my_files.splice(my_files.begin(), my_files, it->second);
+            return it->second->second;
+        }
+
+        H5::H5File handle(path, H5F_ACC_RDONLY);
+        if (my_capacity == 0) {
+            return handle;
+        }
+
+        if (my_files.size() >= my_capacity) {
+            my_index.erase(my_files.back().first);
+            my_files.pop_back();
+        }
+        my_files.emplace_front(path, handle);
+        my_index[path] = my_files.begin();
+        return handle;
+    }
+
+    /**
+     * @return Number of files that are currently open in the pool.
+     */
+    size_t size() const {
+        return my_files.size();
+    }
+
+    /**
+     * Close all files in the pool.
+     */
+    void clear() {
+        my_index.clear();
+        my_files.clear();
+    }
+
+private:
+    void reindex() {
+        my_index.clear();
+        for (auto it = my_files.begin(); it != my_files.end(); ++it) {
+            my_index[it->first] = it;
+        }
+    }
+
+    size_t my_capacity;
+    std::list<std::pair<std::string, H5::H5File> > my_files; // most recently used first.
+    std::unordered_map<std::string, std::list<std::pair<std::string, H5::H5File> >::iterator> my_index;
+};
+
 /**
  * @brief Validation options.
  *
@@ -70,6 +514,105 @@ struct Options {
      */
     bool details_only = false;
 
+    /**
+     * Whether to defer expensive scans of dataset contents (e.g., sparse matrix indices, subset indices, variable-length strings)
+     * until the cheap checks on shapes, types and attributes have been performed throughout the entire delayed object.
+     * This allows invalid objects to fail quickly when the violation does not involve the dataset contents.
+     *
+     * If true, scans are queued in `deferred_scans` and executed by `run_deferred_scans()`.
+     * This is done automatically by the `validate()` overloads that do not accept a `ritsuko::Version`.
+     * Errors from deferred scans have the same message and path as if the scan had not been deferred.
+     */
+    bool defer_scans = false;
+
+    /**
+     * Queue of scans that were deferred when `defer_scans = true`.
+     * Each scan will throw an error if the contents of its dataset are invalid.
+     */
+    std::vector<DeferredScan> deferred_scans;
+
+    /**
+     * Number of threads to use in `run_deferred_scans()`.
+     * If greater than 1, the deferred scans are executed in parallel on worker threads,
+     * while all HDF5 calls are serialized through a single dedicated I/O thread.
+     * This is safe even if the HDF5 library was not built with thread-safety,
+     * provided that no other thread in the application calls HDF5 during `run_deferred_scans()`.
+     */
+    int num_threads = 1;
+
+    /**
+     * Whether to scan the contents of numeric `data` in dense arrays and sparse matrices.
+     * This checks that the values of a `BOOLEAN` array are 0 or 1, and that the values of an `INTEGER` array fit into a 32-bit signed integer,
+     * where the latter is only necessary for older versions of the specification that do not restrict the width of the datatype.
+     * These checks are stricter than the **chihaya** specification, which treats any non-zero value as true and does not restrict the values of older `INTEGER` arrays;
+     * they are intended for applications that want to reject files that are valid but unusual.
+     * Values equal to the missing placeholder are ignored.
+     * Scans are performed block-by-block, in parallel if `num_threads` is greater than 1, and are subject to `defer_scans`.
+     * This has no effect if `details_only = true`.
+     */
+    bool check_data_contents = false;
+
+    /**
+     * Whether to check that the contents of string datasets are valid UTF-8, i.e., in dense arrays, dimnames and unary comparisons.
+     * This is stricter than the **chihaya** specification, which only requires the datatype to be representable by a UTF-8 encoded string;
+     * variable-length strings are always checked for NULL pointers, regardless of this setting.
+     * Scans are subject to `defer_scans`.
+     */
+    bool check_utf8_strings = false;
+
+    /**
+     * Whether to compute statistics for each sparse matrix in the delayed object.
+     * If true, `data` is streamed alongside `indices` in a single pass, and the results are appended to `sparse_statistics`.
+     * This has no effect if `details_only = true`.
+     */
+    bool collect_sparse_statistics = false;
+
+    /**
+     * Statistics for each sparse matrix, filled if `collect_sparse_statistics = true`.
+     * Entries are appended in the order in which the sparse matrices are encountered, even if the scans are deferred;
+     * in the latter case, the contents of each entry are only available after `run_deferred_scans()`.
+     */
+    std::vector<SparseStatistics> sparse_statistics;
+
+    /**
+     * Whether to estimate the cost of realizing each node of the delayed object.
+     * If true, an entry is appended to `node_costs` for each array or operation in the order in which they are encountered.
+     * Typically, this is set by `estimate_cost()` rather than by the caller.
+     */
+    bool collect_costs = false;
+
+    /**
+     * Cost estimates for each node, filled if `collect_costs = true`.
+     */
+    std::vector<NodeCost> node_costs;
+
+    /**
+     * Settings to use when opening a HDF5 file from its path.
+     */
+    FileAccessOptions file_access;
+
+    /**
+     * Whether to resolve external HDF5 arrays by opening the referenced dataset.
+     * If true, the dataset must exist and its extents and datatype must be consistent with the `dimensions` and `type` of the external array.
+     * The dataset's extents are expected to be reversed relative to `dimensions`, consistent with the non-native layout of dense arrays.
+     * Relative paths in `file` are interpreted relative to `external_hdf5_directory`.
+     * This has no effect if `details_only = true`.
+     */
+    bool resolve_external_hdf5 = false;
+
+    /**
+     * Directory against which relative paths in the `file` of external HDF5 arrays are resolved, see `resolve_external_hdf5`.
+     * If empty, the directory containing the file of the external array is used.
+     * This must be supplied to resolve relative paths when validating a file image, as the image has no location on disk.
+     */
+    std::string external_hdf5_directory;
+
+    /**
+     * Pool of open files for resolving external HDF5 arrays.
+     * This may be reused across calls to `validate()` to avoid reopening the same files.
+     */
+    ExternalFilePool external_file_pool;
+
     /**
      * Custom registry of functions to be used by `validate()` on arrays.
      * If a custom function is provided for an array type, it is used instead of the default function .
@@ -0,0 +1,470 @@
+#ifndef CHIHAYA_UTILS_STREAM_HPP
+#define CHIHAYA_UTILS_STREAM_HPP
+
+#include "H5Cpp.h"
+#include "ritsuko/hdf5/hdf5.hpp"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+#include <future>
+#include <memory>
+#include <algorithm>
+#include <deque>
+
+#include "utils_io.hpp"
+#include "utils_chunk.hpp"
+
+#if !defined(CHIHAYA_NO_MMAP) && (defined(__unix__) || defined(__APPLE__))
+#define CHIHAYA_USE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace chihaya {
+
+namespace internal_stream {
+
+/*
+ * Read-only memory mapping of a dataset's raw bytes, bypassing the HDF5
+ * read path entirely. This is only possible if the dataset is stored
+ * contiguously (and thus unfiltered) in a file that is opened read-only with
+ * the default POSIX driver, and if the stored datatype is identical to the
+ * requested in-memory datatype. Otherwise, data() returns NULL and callers
+ * should fall back to the usual HDF5 reads.
+ */
+class MappedDataset {
+public:
+    MappedDataset(const H5::DataSet& handle, const H5::DataType& memtype, hsize_t length) {
+#ifdef CHIHAYA_USE_MMAP
+        if (length == 0) {
+            return;
+        }
+
+        if (handle.getCreatePlist().getLayout() != H5D_CONTIGUOUS || handle.getCreatePlist().getExternalCount() != 0) {
+            return;
+        }
+
+        {
+            auto dtype = handle.getDataType();
+            if (!(dtype == memtype)) {
+                return;
+            }
+        }
+
+        haddr_t address = H5Dget_offset(handle.getId());
+        if (address == HADDR_UNDEF) { // storage not allocated, e.g., all fill values.
+            return;
+        }
+
+        size_t nbytes = length * memtype.getSize();
+        size_t start = address; // already includes any userblock.
+        if (start % memtype.getSize() != 0) { // avoid misaligned access in the mapped array.
+            return;
+        }
+
+        // We map through HDF5's own descriptor rather than re-opening the file
+        // by name, as the name may now refer to a different file, e.g., after
+        // a change of working directory or if the file was replaced.
+        hid_t fid = H5Iget_file_id(handle.getId());
+        if (fid < 0) {
+            return;
+        }
+        int fd = inspect_file(fid);
+        if (fd < 0) {
+            H5Fclose(fid);
+            return;
+        }
+
+        struct stat info;
+        if (::fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < start + nbytes) {
+            H5Fclose(fid);
+            return;
+        }
+
+        size_t page = ::sysconf(_SC_PAGESIZE);
+        size_t aligned = (start / page) * page;
+        my_length = nbytes + (start - aligned);
+        void* ptr = ::mmap(NULL, my_length, PROT_READ, MAP_PRIVATE, fd, aligned); // mapping remains valid after the descriptor is closed.
+        H5Fclose(fid);
+        if (ptr == MAP_FAILED) {
+            return;
+        }
+
+        ::madvise(ptr, my_length, MADV_SEQUENTIAL);
+        my_mapping = ptr;
+        my_data = static_cast<const unsigned char*>(ptr) + (start - aligned);
+#else
+        (void)handle;
+        (void)memtype;
+        (void)length;
+#endif
+    }
+
+    ~MappedDataset() {
+#ifdef CHIHAYA_USE_MMAP
+        if (my_mapping) {
+            ::munmap(my_mapping, my_length);
+        }
+#endif
+    }
+
+    MappedDataset(const MappedDataset&) = delete;
+    MappedDataset& operator=(const MappedDataset&) = delete;
+
+private:
+#ifdef CHIHAYA_USE_MMAP
+    // Returns the POSIX file descriptor used by HDF5, or -1 if the file cannot be mapped.
+    static int inspect_file(hid_t fid) {
+        unsigned intent;
+        if (H5Fget_intent(fid, &intent) < 0 || intent != H5F_ACC_RDONLY) { // unflushed writes would not be visible in the mapping.
+            return -1;
+        }
+
+        hid_t fapl = H5Fget_access_plist(fid);
+        if (fapl < 0) {
+            return -1;
+        }
+        bool is_sec2 = (H5Pget_driver(fapl) == H5FD_SEC2);
+        H5Pclose(fapl);
+        if (!is_sec2) {
+            return -1;
+        }
+
+        void* vfd_handle = NULL;
+        if (H5Fget_vfd_handle(fid, H5P_DEFAULT, &vfd_handle) < 0 || vfd_handle == NULL) {
+            return -1;
+        }
+        return *static_cast<int*>(vfd_handle);
+    }
+#endif
+
+public:
+    const void* data() const {
+        return my_data;
+    }
+
+private:
+    void* my_mapping = NULL;
+    size_t my_length = 0;
+    const void* my_data = NULL;
+};
+
+// Same interface as ritsuko::hdf5::Stream1dNumericDataset, but reading
+// directly from a memory-mapped array of length 'length'.
+template<typename Type_>
+class MappedStream1dNumericDataset {
+public:
+    MappedStream1dNumericDataset(const H5::DataSet* ptr, const Type_* data, hsize_t length) : my_ptr(ptr), my_data(data), my_length(length) {}
+
+    Type_ get() const {
+        if (my_position >= my_length) {
+            throw std::runtime_error("requesting data beyond the end of the dataset at '" + internal_io::serialize([&]() -> std::string { return my_ptr->getObjName(); }) + "'");
+        }
+        return my_data[my_position];
+    }
+
+    void next(size_t jump = 1) {
+        my_position += jump;
+    }
+
+private:
+    const H5::DataSet* my_ptr;
+    const Type_* my_data;
+    hsize_t my_length;
+    hsize_t my_position = 0;
+};
+
+/*
+ * Same interface as ritsuko::hdf5::Stream1dNumericDataset, but with double
+ * buffering. The I/O service reads (and decompresses) the next block while the
+ * caller is processing the current block. All HDF5 calls are performed by the
+ * service, so this stream can be used from any thread.
+ */
+template<typename Type_>
+class PrefetchStream1dNumericDataset {
+public:
+    PrefetchStream1dNumericDataset(const H5::DataSet* ptr, hsize_t length, hsize_t block_size, internal_io::Service& service) : 
+        my_ptr(ptr), 
+        my_length(length),
+        my_block_size(block_size),
+        my_service(service)
+    {
+        for (int b = 0; b < 2; ++b) {
+            my_buffers[b].resize(my_block_size);
+            request(b);
+        }
+    }
+
+    ~PrefetchStream1dNumericDataset() {
+        // Buffers must outlive any outstanding reads.
+        for (int b = 0; b < 2; ++b) {
+            if (my_pending[b].valid()) {
+                my_pending[b].wait();
+            }
+        }
+    }
+
+    PrefetchStream1dNumericDataset(const PrefetchStream1dNumericDataset&) = delete;
+    PrefetchStream1dNumericDataset& operator=(const PrefetchStream1dNumericDataset&) = delete;
+
+public:
+    Type_ get() {
+        while (my_consumed >= my_available) {
+            my_consumed -= my_available;
+            acquire();
+        }
+        return my_buffers[my_current][my_consumed];
+    }
+
+    void next(size_t jump = 1) {
+        my_consumed += jump;
+    }
+
+private:
+    const H5::DataSet* my_ptr;
+    hsize_t my_length, my_block_size;
+    internal_io::Service& my_service;
+
+    std::vector<Type_> my_buffers[2];
+    std::future<void> my_pending[2];
+    hsize_t my_requested = 0;
+
+    bool my_started = false;
+    int my_current = 0;
+    hsize_t my_delivered = 0;
+    hsize_t my_consumed = 0;
+    hsize_t my_available = 0;
+
+private:
+    void request(int target) {
+        if (my_requested >= my_length) {
+            return;
+        }
+
+        hsize_t start = my_requested;
+        hsize_t count = std::min(my_length - start, my_block_size);
+        my_requested += count;
+
+        auto bptr = my_buffers[target].data();
+        my_pending[target] = my_service.submit([this, bptr, start, count]() -> void {
+            H5::DataSpace mspace(1, &count), dspace(1, &my_length);
+            dspace.selectHyperslab(H5S_SELECT_SET, &count, &start);
+            my_ptr->read(bptr, ritsuko::hdf5::as_numeric_datatype<Type_>(), mspace, dspace);
+        });
+    }
+
+    void acquire() {
+        if (my_started) {
+            request(my_current); // refilling the buffer that was just consumed.
+            my_current = 1 - my_current;
+        }
+        my_started = true;
+
+        if (my_delivered >= my_length) {
+            throw std::runtime_error("requesting data beyond the end of the dataset at '" + my_service.run([&]() -> std::string { return my_ptr->getObjName(); }) + "'");
+        }
+
+        my_pending[my_current].get(); // re-throws any errors from the read.
+        my_available = std::min(my_length - my_delivered, my_block_size);
+        my_delivered += my_available;
+    }
+};
+
+/*
+ * Same interface as ritsuko::hdf5::Stream1dNumericDataset, but bypassing the
+ * HDF5 filter pipeline. The I/O service only fetches the raw chunks, which are
+ * then decompressed on the worker threads in 'pool' (if supplied) or by the
+ * caller, so that multiple chunks can be decompressed at the same time.
+ */
+template<typename Type_>
+class ChunkedStream1dNumericDataset {
+public:
+    ChunkedStream1dNumericDataset(
+        const H5::DataSet* ptr,
+        hsize_t length,
+        internal_chunk::Layout layout,
+        internal_io::Service& service,
+        std::vector<std::unique_ptr<internal_io::Service> >* pool) :
+        my_ptr(ptr),
+        my_length(length),
+        my_layout(std::move(layout)),
+        my_service(service),
+        my_pool(pool)
+    {
+        my_num_chunks = (my_length + my_layout.chunk_length - 1) / my_layout.chunk_length;
+        size_t window = (my_pool ? 2 * my_pool->size() : 2);
+        for (size_t w = 0; w < window; ++w) {
+            request();
+        }
+    }
+
+    ~ChunkedStream1dNumericDataset() {
+        // Outstanding tasks refer to this object, so we need to wait for them.
+        for (auto& p : my_pending) {
+            if (p.decoded.valid()) {
+                p.decoded.wait();
+            }
+            if (p.raw.valid()) {
+                p.raw.wait();
+            }
+        }
+    }
+
+    ChunkedStream1dNumericDataset(const ChunkedStream1dNumericDataset&) = delete;
+    ChunkedStream1dNumericDataset& operator=(const ChunkedStream1dNumericDataset&) = delete;
+
+public:
+    Type_ get() {
+        while (my_consumed >= my_available) {
+            my_consumed -= my_available;
+            acquire();
+        }
+        return my_current[my_consumed];
+    }
+
+    void next(size_t jump = 1) {
+        my_consumed += jump;
+    }
+
+private:
+    const H5::DataSet* my_ptr;
+    hsize_t my_length;
+    internal_chunk::Layout my_layout;
+    internal_io::Service& my_service;
+    std::vector<std::unique_ptr<internal_io::Service> >* my_pool;
+
+    struct Pending {
+        std::future<internal_chunk::RawChunk> raw; // used if the caller decompresses.
+        std::future<std::vector<Type_> > decoded; // used if the pool decompresses.
+    };
+    std::deque<Pending> my_pending;
+    hsize_t my_num_chunks = 0;
+    hsize_t my_requested = 0;
+
+    std::vector<Type_> my_current;
+    hsize_t my_delivered = 0;
+    hsize_t my_consumed = 0;
+    hsize_t my_available = 0;
+
+private:
+    std::vector<Type_> decode(internal_chunk::RawChunk& raw) const {
+        std::vector<Type_> output(my_layout.chunk_length);
+        internal_chunk::decode(raw, my_layout, reinterpret_cast<unsigned char*>(output.data()));
+        return output;
+    }
+
+    void request() {
+        if (my_requested >= my_num_chunks) {
+            return;
+        }
+
+        hsize_t index = my_requested;
+        ++my_requested;
+        auto reader = [this, index]() -> internal_chunk::RawChunk {
+            return internal_chunk::read_raw(*my_ptr, my_layout, index);
+        };
+
+        my_pending.emplace_back();
+        auto& current = my_pending.back();
+        if (my_pool) {
+            auto& worker = *((*my_pool)[index % my_pool->size()]);
+            current.decoded = worker.submit([this, reader]() -> std::vector<Type_> {
+                auto raw = my_service.submit(reader).get();
+                return decode(raw);
+            });
+        } else {
+            current.raw = my_service.submit(reader);
+        }
+    }
+
+    void acquire() {
+        if (my_delivered >= my_length) {
+            throw std::runtime_error("requesting data beyond the end of the dataset at '" + my_service.run([&]() -> std::string { return my_ptr->getObjName(); }) + "'");
+        }
+
+        auto current = std::move(my_pending.front());
+        my_pending.pop_front();
+        request();
+
+        if (current.decoded.valid()) {
+            my_current = current.decoded.get(); // re-throws any errors from the read or decompression.
+        } else {
+            auto raw = current.raw.get();
+            my_current = decode(raw);
+        }
+
+        my_available = std::min(my_length - my_delivered, static_cast<hsize_t>(my_layout.chunk_length));
+        my_delivered += my_available;
+    }
+};
+
+// Calls 'fun' with a stream over the first 'length' elements of a 1-dimensional
+// dataset. This uses a memory mapping where possible. Otherwise, if an I/O
+// service is active for the current thread, reads are performed through that
+// service; if the dataset spans multiple blocks, the next block is prefetched
+// in a dedicated I/O thread; and for small datasets, the data is read directly.
+// Datasets compressed with deflate and/or shuffle are decompressed outside of
+// HDF5, using up to 'num_threads' threads if no I/O service is already active.
+template<typename Type_, class Function_>
+void stream_1d_numeric_dataset(const H5::DataSet& handle, hsize_t length, hsize_t buffer_size, int num_threads, Function_ fun) {
+    auto mapped = internal_io::serialize([&]() -> std::unique_ptr<MappedDataset> {
+        return std::make_unique<MappedDataset>(handle, ritsuko::hdf5::as_numeric_datatype<Type_>(), length);
+    });
+    if (mapped->data()) {
+        MappedStream1dNumericDataset<Type_> stream(&handle, static_cast<const Type_*>(mapped->data()), length);
+        fun(stream);
+        return;
+    }
+
+    auto service = internal_io::current_service();
+
+    // Our own decompression only pays off if it can run in parallel,
+    // otherwise we stick to HDF5's filter pipeline.
+    if (num_threads > 1) {
+        auto layout = internal_io::serialize([&]() -> internal_chunk::Layout {
+            return internal_chunk::inspect(handle, ritsuko::hdf5::as_numeric_datatype<Type_>(), length);
+        });
+        if (layout.supported && layout.chunk_length < length) {
+            if (service) {
+                // Already running in parallel across datasets, so the caller decompresses.
+                ChunkedStream1dNumericDataset<Type_> stream(&handle, length, std::move(layout), *service, NULL);
+                fun(stream);
+            } else {
+                internal_io::Service dedicated;
+                std::vector<std::unique_ptr<internal_io::Service> > pool;
+                for (int t = 0; t < num_threads; ++t) {
+                    pool.emplace_back(new internal_io::Service);
+                }
+                ChunkedStream1dNumericDataset<Type_> stream(&handle, length, std::move(layout), dedicated, &pool);
+                fun(stream);
+            }
+            return;
+        }
+    }
+
+    auto block_size = internal_io::serialize([&]() -> hsize_t {
+        return ritsuko::hdf5::pick_1d_block_size(handle.getCreatePlist(), length, buffer_size);
+    });
+
+    if (service) {
+        PrefetchStream1dNumericDataset<Type_> stream(&handle, length, block_size, *service);
+        fun(stream);
+    } else if (block_size < length) {
+        internal_io::Service dedicated;
+        PrefetchStream1dNumericDataset<Type_> stream(&handle, length, block_size, dedicated);
+        fun(stream);
+    } else {
+        ritsuko::hdf5::Stream1dNumericDataset<Type_> stream(&handle, length, buffer_size);
+        fun(stream);
+    }
+}
+
+}
+
+}
+
+#endif
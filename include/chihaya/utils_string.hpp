@@ -0,0 +1,288 @@
+#ifndef CHIHAYA_UTILS_STRING_HPP
+#define CHIHAYA_UTILS_STRING_HPP
+
+#include "H5Cpp.h"
+
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include <algorithm>
+#include <cstddef>
+
+#include "utils_public.hpp"
+#include "utils_io.hpp"
+
+namespace chihaya {
+
+namespace internal_string {
+
+// Checks 8 bytes at a time with a branch-free accumulation, which the
+// compiler can vectorize further. Most strings in practice (e.g., gene IDs,
+// cell barcodes) are pure ASCII, so this is the common case.
+inline bool is_ascii(const char* ptr, size_t n) {
+    uint64_t acc = 0;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, ptr + i, 8);
+        acc |= word;
+    }
+    for (; i < n; ++i) {
+        acc |= static_cast<unsigned char>(ptr[i]);
+    }
+    return (acc & 0x8080808080808080ull) == 0;
+}
+
+// Rejects truncated or overlong sequences, surrogates and code points beyond
+// U+10FFFF. Runs of ASCII characters are skipped 8 bytes at a time.
+inline bool is_utf8(const char* ptr, size_t n) {
+    auto uptr = reinterpret_cast<const unsigned char*>(ptr);
+    size_t i = 0;
+    while (i < n) {
+        if (i + 8 <= n) {
+            uint64_t word;
+            std::memcpy(&word, uptr + i, 8);
+            if ((word & 0x8080808080808080ull) == 0) {
+                i += 8;
+                continue;
+            }
+        }
+
+        unsigned char lead = uptr[i];
+        if (lead < 0x80) {
+            ++i;
+            continue;
+        }
+
+        size_t len;
+        uint32_t point, lowest;
+        if ((lead & 0xE0) == 0xC0) {
+            len = 2;
+            point = lead & 0x1F;
+            lowest = 0x80;
+        } else if ((lead & 0xF0) == 0xE0) {
+            len = 3;
+            point = lead & 0x0F;
+            lowest = 0x800;
+        } else if ((lead & 0xF8) == 0xF0) {
+            len = 4;
+            point = lead & 0x07;
+            lowest = 0x10000;
+        } else {
+            return false;
+        }
+
+        if (len > n - i) {
+            return false;
+        }
+        for (size_t k = 1; k < len; ++k) {
+            unsigned char cont = uptr[i + k];
+            if ((cont & 0xC0) != 0x80) {
+                return false;
+            }
+            point = (point << 6) | (cont & 0x3F);
+        }
+        if (point < lowest || point > 0x10FFFF || (point >= 0xD800 && point <= 0xDFFF)) {
+            return false;
+        }
+        i += len;
+    }
+    return true;
+}
+
+/*
+ * Bump allocator for the variable-length strings in a single read, to be
+ * registered with H5Pset_vlen_mem_manager. This avoids a heap allocation per
+ * string during the read and the corresponding H5Dvlen_reclaim afterwards;
+ * instead, the entire arena is reset before the next block is read. Pages are
+ * retained across resets so that steady-state reads do not allocate at all.
+ */
+class Arena {
+public:
+    Arena(size_t page_size = 1048576) : my_page_size(page_size) {}
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+public:
+    void* allocate(size_t n) {
+        n = (n + alignment - 1) / alignment * alignment;
+        if (n == 0) {
+            n = alignment; // HDF5 expects a unique non-NULL pointer.
+        }
+
+        while (my_current < my_pages.size()) {
+            if (my_offset + n <= my_pages[my_current].size()) {
+                void* output = my_pages[my_current].data() + my_offset;
+                my_offset += n;
+                return output;
+            }
+            ++my_current;
+            my_offset = 0;
+        }
+
+        my_pages.emplace_back(std::max(my_page_size, n));
+        my_offset = n;
+        return my_pages.back().data();
+    }
+
+    void reset() {
+        my_current = 0;
+        my_offset = 0;
+    }
+
+    size_t num_pages() const {
+        return my_pages.size();
+    }
+
+public:
+    static void* allocate_callback(size_t n, void* info) {
+        return static_cast<Arena*>(info)->allocate(n);
+    }
+
+    static void free_callback(void*, void*) {}
+
+    // Dataset transfer property list that directs HDF5 to allocate from this arena.
+    H5::DSetMemXferPropList transfer_plist() {
+        H5::DSetMemXferPropList xfer;
+        H5Pset_vlen_mem_manager(xfer.getId(), allocate_callback, this, free_callback, this);
+        return xfer;
+    }
+
+private:
+    static constexpr size_t alignment = alignof(std::max_align_t);
+    size_t my_page_size;
+    std::vector<std::vector<unsigned char> > my_pages;
+    size_t my_current = 0;
+    size_t my_offset = 0;
+};
+
+/*
+ * Whether the string dataset needs to be scanned at all. Fixed-length strings
+ * can never be NULL, so they only need to be read when checking UTF-8.
+ */
+inline bool needs_scan(const H5::DataSet& handle, bool check_utf8) {
+    return check_utf8 || handle.getStrType().isVariableStr();
+}
+
+/*
+ * Validates the contents of an N-dimensional string dataset in blocks of
+ * slices along the first dimension. Variable-length strings must not be NULL,
+ * and if 'check_utf8' is true, all strings must be valid UTF-8. Variable-length
+ * strings are allocated from an arena that is reset for each block. For
+ * fixed-length strings, the entire block is first checked for pure ASCII, in
+ * which case no per-string checks are required; otherwise, each string is
+ * checked up to its terminator. All HDF5 calls are serialized so that this can
+ * be run on worker threads.
+ */
+inline void validate_string_dataset(const H5::DataSet& handle, const std::vector<hsize_t>& dims, hsize_t buffer_size, bool check_utf8) {
+    hsize_t slice = 1;
+    for (size_t d = 1; d < dims.size(); ++d) {
+        slice *= dims[d];
+    }
+    hsize_t extent = (dims.empty() ? 1 : dims[0]);
+    if (extent == 0 || slice == 0) {
+        return;
+    }
+
+    internal_io::SerializedObject<H5::StrType> stype([&]() -> H5::StrType { return handle.getStrType(); });
+    bool is_variable;
+    size_t size;
+    bool nul_terminated;
+    internal_io::serialize([&]() -> void {
+        is_variable = (*stype).isVariableStr();
+        size = (*stype).getSize();
+        nul_terminated = ((*stype).getStrpad() != H5T_STR_SPACEPAD);
+    });
+    if (!is_variable && !check_utf8) {
+        return;
+    }
+
+    hsize_t rows = std::max(static_cast<hsize_t>(1), buffer_size / slice);
+    rows = std::min(rows, extent);
+
+    auto select = [&](hsize_t start, hsize_t count, H5::DataSpace& mspace, H5::DataSpace& dspace) -> void {
+        dspace = handle.getSpace();
+        if (!dims.empty()) {
+            std::vector<hsize_t> hstart(dims.size()), hcount(dims);
+            hstart[0] = start;
+            hcount[0] = count;
+            dspace.selectHyperslab(H5S_SELECT_SET, hcount.data(), hstart.data());
+        }
+        hsize_t total = count * slice;
+        mspace = H5::DataSpace(1, &total);
+    };
+
+    if (is_variable) {
+        std::vector<char*> buffer;
+        Arena arena;
+        internal_io::SerializedObject<H5::DSetMemXferPropList> xfer([&]() -> H5::DSetMemXferPropList { return arena.transfer_plist(); });
+
+        for (hsize_t start = 0; start < extent; start += rows) {
+            hsize_t count = std::min(rows, extent - start);
+            buffer.resize(count * slice);
+            arena.reset();
+            internal_io::serialize([&]() -> void {
+                H5::DataSpace mspace, dspace;
+                select(start, count, mspace, dspace);
+                handle.read(buffer.data(), *stype, mspace, dspace, *xfer);
+            });
+
+            bool null_found = false;
+            size_t failed = buffer.size();
+            for (size_t i = 0; i < buffer.size(); ++i) {
+                auto ptr = buffer[i];
+                if (ptr == NULL) {
+                    null_found = true;
+                    failed = i;
+                    break;
+                }
+                if (check_utf8 && !is_utf8(ptr, std::strlen(ptr))) {
+                    failed = i;
+                    break;
+                }
+            }
+
+            if (null_found) {
+                throw ValidationError(ErrorCode::INVALID, "detected a NULL pointer for a variable length string", start * slice + failed);
+            } else if (failed < buffer.size()) {
+                throw ValidationError(ErrorCode::INVALID, "detected a string that is not valid UTF-8", start * slice + failed);
+            }
+        }
+
+    } else {
+        std::vector<char> buffer;
+        for (hsize_t start = 0; start < extent; start += rows) {
+            hsize_t count = std::min(rows, extent - start);
+            buffer.resize(count * slice * size);
+            internal_io::serialize([&]() -> void {
+                H5::DataSpace mspace, dspace;
+                select(start, count, mspace, dspace);
+                handle.read(buffer.data(), *stype, mspace, dspace);
+            });
+
+            if (is_ascii(buffer.data(), buffer.size())) {
+                continue;
+            }
+
+            for (size_t i = 0, n = count * slice; i < n; ++i) {
+                const char* ptr = buffer.data() + i * size;
+                size_t len = size;
+                if (nul_terminated) {
+                    len = std::find(ptr, ptr + size, '\0') - ptr;
+                }
+                if (!is_utf8(ptr, len)) {
+                    throw ValidationError(ErrorCode::INVALID, "detected a string that is not valid UTF-8", start * slice + i);
+                }
+            }
+        }
+    }
+}
+
+}
+
+}
+
+#endif
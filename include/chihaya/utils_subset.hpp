@@ -6,34 +6,45 @@
 
 #include <vector>
 #include <stdexcept>
+#include <cstdint>
+#include <type_traits>
 
 #include "utils_list.hpp"
 #include "utils_misc.hpp"
+#include "utils_stream.hpp"
 
 namespace chihaya {
 
 namespace internal_subset {
 
-template<typename Index_>
-void validate_indices(const H5::DataSet& dhandle, size_t len, size_t extent) {
-    ritsuko::hdf5::Stream1dNumericDataset<Index_> stream(&dhandle, len, 1000000);
+template<typename Index_, class Stream_>
+void scan_indices(Stream_& stream, size_t len, size_t extent) {
     for (size_t i = 0; i < len; ++i, stream.next()) {
         auto b = stream.get();
-        if (b < 0) {
-            throw std::runtime_error("indices should be non-negative");
+        if constexpr(std::is_signed<Index_>::value) {
+            if (b < 0) {
+                throw ValidationError(ErrorCode::INVALID_INDEX, "indices should be non-negative", i);
+            }
         }
         if (static_cast<size_t>(b) >= extent) {
-            throw std::runtime_error("indices out of range");
+            throw ValidationError(ErrorCode::INVALID_INDEX, "indices out of range", i);
         }
     }
 }
 
-inline std::vector<std::pair<size_t, size_t> > validate_index_list(const H5::Group& ihandle, const std::vector<size_t>& seed_dims, const ritsuko::Version& version) {
+template<typename Index_>
+void validate_indices(const H5::DataSet& dhandle, size_t len, size_t extent, int num_threads) {
+    internal_stream::stream_1d_numeric_dataset<Index_>(dhandle, len, 1000000, num_threads, [&](auto& stream) -> void {
+        scan_indices<Index_>(stream, len, extent);
+    });
+}
+
+inline std::vector<std::pair<size_t, size_t> > validate_index_list(const H5::Group& ihandle, const std::vector<size_t>& seed_dims, const ritsuko::Version& version, Options& options) {
     internal_list::ListDetails list_params;
     try {
         list_params = internal_list::validate(ihandle, version);
     } catch (std::exception& e) {
-        throw std::runtime_error("failed to load 'index' list; " + std::string(e.what()));
+        internal_misc::rethrow_with_context(e, "failed to load 'index' list", "index");
     }
 
     if (list_params.length != seed_dims.size()) {
@@ -43,25 +54,32 @@ inline std::vector<std::pair<size_t, size_t> > validate_index_list(const H5::Gro
     std::vector<std::pair<size_t, size_t> > collected;
 
     for (const auto& p : list_params.present) {
+        internal_misc::ContextScope context(options, "failed to validate 'index/", p.name, "'", "index/");
         try {
-            auto dhandle = ritsuko::hdf5::open_dataset(ihandle, p.second.c_str());
+            auto dhandle = internal_list::open_dataset(ihandle, p);
             auto len = ritsuko::hdf5::get_1d_length(dhandle, false);
 
             if (version.lt(1, 1, 0)) {
                 if (dhandle.getTypeClass() != H5T_INTEGER) {
                     throw std::runtime_error("expected an integer dataset");
                 }
-                validate_indices<int>(dhandle, len, seed_dims[p.first]);
+                internal_misc::scan_or_defer(dhandle, len, options, [=, extent = seed_dims[p.index], num_threads = options.num_threads]() -> void {
+                    validate_indices<int>(dhandle, len, extent, num_threads);
+                });
             } else {
                 if (ritsuko::hdf5::exceeds_integer_limit(dhandle, 64, false)) {
                     throw std::runtime_error("datatype should be exactly represented by a 64-bit unsigned integer");
                 }
-                validate_indices<uint64_t>(dhandle, len, seed_dims[p.first]);
+                internal_misc::visit_unsigned_index_type(dhandle, [&](auto x) -> void {
+                    internal_misc::scan_or_defer(dhandle, len, options, [=, extent = seed_dims[p.index], num_threads = options.num_threads]() -> void {
+                        validate_indices<decltype(x)>(dhandle, len, extent, num_threads);
+                    });
+                });
             }
 
-            collected.emplace_back(p.first, len);
+            collected.emplace_back(p.index, len);
         } catch (std::exception& e) {
-            throw std::runtime_error("failed to validate 'index/" + p.second + "'; " + std::string(e.what()));
+            context.rethrow(e);
         }
     }
 
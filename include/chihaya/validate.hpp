@@ -31,9 +31,15 @@
 #include "matrix_product.hpp"
 
 #include "utils_public.hpp"
+#include "utils_io.hpp"
+#include "utils_file.hpp"
+#include "utils_cost.hpp"
 
 #include <string>
 #include <stdexcept>
+#include <algorithm>
+#include <vector>
+#include <exception>
 
 /**
  * @file validate.hpp
@@ -90,6 +96,7 @@ inline auto default_array_registry() {
  * @return Details of the array after all delayed operations in `handle` (and its children) have been applied.
  */
 inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& version, Options& options) {
+    internal_cost::NodeScope cost_scope(handle, options);
     auto dtype = ritsuko::hdf5::open_and_load_scalar_string_attribute(handle, "delayed_type");
     ArrayDetails output;
 
@@ -99,35 +106,39 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
         const auto& custom = options.array_validate_registry;
         auto cit = custom.find(atype);
         if (cit != custom.end()) {
+            internal_misc::ContextScope context(options, "failed to validate delayed array of type '", atype, "'");
             try {
                 output = (cit->second)(handle, version, options);
             } catch (std::exception& e) {
-                throw std::runtime_error("failed to validate delayed array of type '" + atype + "'; " + std::string(e.what()));
+                context.rethrow(e);
             }
 
         } else {
             static const auto global = internal::default_array_registry();
             auto git = global.find(atype);
             if (git != global.end()) {
+                internal_misc::ContextScope context(options, "failed to validate delayed array of type '", atype, "'");
                 try {
                     output = (git->second)(handle, version, options);
                 } catch (std::exception& e) {
-                    throw std::runtime_error("failed to validate delayed array of type '" + atype + "'; " + std::string(e.what()));
+                    context.rethrow(e);
                 }
             } else if (atype.rfind("custom ", 0) != std::string::npos) {
+                internal_misc::ContextScope context(options, "failed to validate delayed array of type '", atype, "'");
                 try {
                     output = custom_array::validate(handle, version, options);
                 } catch (std::exception& e) {
-                    throw std::runtime_error("failed to validate delayed array of type '" + atype + "'; " + std::string(e.what()));
+                    context.rethrow(e);
                 }
             } else if (atype.rfind("external hdf5 ", 0) != std::string::npos && version.lt(1, 1, 0)) {
+                internal_misc::ContextScope context(options, "failed to validate delayed array of type '", atype, "'");
                 try {
                     output = external_hdf5::validate(handle, version, options);
                 } catch (std::exception& e) {
-                    throw std::runtime_error("failed to validate delayed array of type '" + atype + "'; " + std::string(e.what()));
+                    context.rethrow(e);
                 }
             } else {
-                throw std::runtime_error("unknown array type '" + atype + "'");
+                throw ValidationError(ErrorCode::UNKNOWN_TYPE, "unknown array type '" + atype + "'");
             }
         }
 
@@ -137,28 +148,34 @@ inline ArrayDetails validate(const H5::Group& handle, const ritsuko::Version& ve
         const auto& custom = options.operation_validate_registry;
         auto cit = custom.find(otype);
         if (cit != custom.end()) {
+            internal_misc::ContextScope context(options, "failed to validate delayed operation of type '", otype, "'");
             try {
                 output = (cit->second)(handle, version, options);
             } catch (std::exception& e) {
-                throw std::runtime_error("failed to validate delayed operation of type '" + otype + "'; " + std::string(e.what()));
+                context.rethrow(e);
             }
 
         } else {
             static const auto global = internal::default_operation_registry();
             auto git = global.find(otype);
             if (git != global.end()) {
+                internal_misc::ContextScope context(options, "failed to validate delayed operation of type '", otype, "'");
                 try {
                     output = (git->second)(handle, version, options);
                 } catch (std::exception& e) {
-                    throw std::runtime_error("failed to validate delayed operation of type '" + otype + "'; " + std::string(e.what()));
+                    context.rethrow(e);
                 }
             } else {
-                throw std::runtime_error("unknown operation type '" + otype + "'");
+                throw ValidationError(ErrorCode::UNKNOWN_TYPE, "unknown operation type '" + otype + "'");
             }
         }
 
     } else {
-        throw std::runtime_error("unknown delayed type '" + dtype + "'");
+        throw ValidationError(ErrorCode::UNKNOWN_TYPE, "unknown delayed type '" + dtype + "'");
+    }
+
+    if (cost_scope.active()) {
+        internal_cost::fill(handle, dtype, output, options.node_costs, cost_scope.index());
     }
 
     return output;
@@ -195,15 +212,50 @@ inline ritsuko::Version extract_version(const H5::Group& handle) {
     return version;
 }
 
+/**
+ * Execute all scans in `options.deferred_scans`, see `Options::defer_scans` for details.
+ * Scans are executed in order of increasing size so that errors in small datasets are reported as quickly as possible.
+ * If `Options::num_threads` is greater than 1, scans are executed in parallel, see `Options::num_threads` for details.
+ * The queue is always emptied by this function, even if one of the scans fails.
+ *
+ * @param options Validation options, containing the deferred scans.
+ * An error is raised if any of the scans fail, with the same context and path as if the scan had not been deferred.
+ * For parallel execution, the error is that of the smallest failing scan.
+ */
+inline void run_deferred_scans(Options& options) {
+    auto scans = std::move(options.deferred_scans);
+    options.deferred_scans.clear();
+    std::stable_sort(scans.begin(), scans.end(), [](const DeferredScan& left, const DeferredScan& right) -> bool { return left.size < right.size; });
+
+    std::exception_ptr error;
+    internal_io::parallelize(scans.size(), options.num_threads, [&](size_t s) -> void {
+        scans[s].run();
+    }, error);
+
+    if (error) {
+        // Deferred scans already carry the context of their enclosing nodes.
+        std::rethrow_exception(error);
+    }
+}
+
 /**
  * Validate a delayed operation/array at the specified HDF5 group,
+ * If `Options::defer_scans = true`, all deferred scans are executed after the cheap checks have been performed on the entire delayed object.
  * 
  * @param handle Open handle to a HDF5 group corresponding to a delayed operation or array.
  * @param options Validation options, see `validate()` for details.
  * @return Details of the array after all delayed operations in `handle` (and its children) have been applied.
  */
 inline ArrayDetails validate(const H5::Group& handle, Options& options) {
-    return validate(handle, extract_version(handle), options);
+    ArrayDetails output;
+    try {
+        output = validate(handle, extract_version(handle), options);
+    } catch (...) {
+        options.deferred_scans.clear();
+        throw;
+    }
+    run_deferred_scans(options);
+    return output;
 }
 
 /**
@@ -213,11 +265,12 @@ inline ArrayDetails validate(const H5::Group& handle, Options& options) {
  * @param path Path to a HDF5 file.
  * @param name Name of the group inside the file.
  * @param options Validation options, see `validate()` for details.
+ * The file is opened with the settings in `Options::file_access`.
  *
  * @return Details of the array after all delayed operations have been applied.
  */
 inline ArrayDetails validate(const std::string& path, const std::string& name, Options& options) {
-    H5::H5File handle(path, H5F_ACC_RDONLY);
+    auto handle = internal_file::open(path, options.file_access);
     auto ghandle = handle.openGroup(name);
     return validate(ghandle, options);
 }
@@ -238,6 +291,148 @@ inline ArrayDetails validate(const std::string& path, const std::string& name) {
     return validate(ghandle, options);
 }
 
+/**
+ * Validate a delayed operation/array in a HDF5 file image, i.e., the contents of a HDF5 file that have been loaded into memory.
+ * This avoids the need to write the file to disk, e.g., for files received over a network.
+ * The buffer is used directly by the HDF5 library without any copies.
+ * 
+ * @param data Pointer to the file image.
+ * This should remain valid and unmodified for the duration of the call.
+ * @param size Size of the file image in bytes.
+ * @param name Name of the group inside the file.
+ * @param options Validation options, see `validate()` for details.
+ * Only the `FileAccessOptions::metadata_cache_size` setting in `Options::file_access` is used.
+ *
+ * @return Details of the array after all delayed operations have been applied.
+ */
+inline ArrayDetails validate(const void* data, size_t size, const std::string& name, Options& options) {
+    internal_file::ImageBuffer image; // must outlive the file handle.
+    auto handle = internal_file::open(data, size, options.file_access, image);
+    auto ghandle = handle.openGroup(name);
+    return validate(ghandle, options);
+}
+
+/**
+ * Validate a delayed operation/array in a HDF5 file image with default options.
+ * 
+ * @param data Pointer to the file image.
+ * This should remain valid and unmodified for the duration of the call.
+ * @param size Size of the file image in bytes.
+ * @param name Name of the group inside the file.
+ *
+ * @return Details of the array after all delayed operations have been applied.
+ */
+inline ArrayDetails validate(const void* data, size_t size, const std::string& name) {
+    Options options;
+    return validate(data, size, name, options);
+}
+
+/**
+ * Validate a delayed operation/array at the specified HDF5 group, catching any error.
+ * This is a convenience wrapper that calls `validate()` and converts any error into a `ValidationStatus`.
+ * Errors are still propagated as exceptions inside the validators, so this is not any faster than catching the error from `validate()`;
+ * it only avoids assembling the full error message, see `ValidationError::what()`.
+ *
+ * @param handle Open handle to a HDF5 group corresponding to a delayed operation or array.
+ * @param options Validation options, see `validate()` for details.
+ *
+ * @return Status of the validation.
+ * If the validation failed, this contains the error code, the path to the offending node and (for index scans) the position of the offending element.
+ */
+inline ValidationStatus try_validate(const H5::Group& handle, Options& options) {
+    ValidationStatus output;
+    try {
+        output.details = validate(handle, options);
+    } catch (ValidationError& e) {
+        output.error = std::move(e);
+    } catch (std::exception& e) {
+        output.error = ValidationError(ErrorCode::INVALID, e.what());
+    } catch (H5::Exception& e) {
+        output.error = ValidationError(ErrorCode::HDF5_ERROR, e.getDetailMsg());
+    }
+    return output;
+}
+
+/**
+ * Validate a delayed operation/array at the specified HDF5 group, catching any error.
+ * Errors from opening the file or group are also captured in the returned status.
+ *
+ * @param path Path to a HDF5 file.
+ * @param name Name of the group inside the file.
+ * @param options Validation options, see `validate()` for details.
+ * The file is opened with the settings in `Options::file_access`.
+ *
+ * @return Status of the validation, see the `try_validate()` overload for a `H5::Group`.
+ */
+inline ValidationStatus try_validate(const std::string& path, const std::string& name, Options& options) {
+    ValidationStatus output;
+    try {
+        auto handle = internal_file::open(path, options.file_access);
+        auto ghandle = handle.openGroup(name);
+        return try_validate(ghandle, options);
+    } catch (std::exception& e) {
+        output.error = ValidationError(ErrorCode::INVALID, e.what());
+    } catch (H5::Exception& e) {
+        output.error = ValidationError(ErrorCode::HDF5_ERROR, e.getDetailMsg());
+    }
+    return output;
+}
+
+/**
+ * Validate a delayed operation/array at the specified HDF5 group, catching any error.
+ * 
+ * @param path Path to a HDF5 file.
+ * @param name Name of the group inside the file.
+ *
+ * @return Status of the validation, see the `try_validate()` overload for a `H5::Group`.
+ */
+inline ValidationStatus try_validate(const std::string& path, const std::string& name) {
+    Options options;
+    return try_validate(path, name, options);
+}
+
+/**
+ * Validate a delayed operation/array in a HDF5 file image, catching any error.
+ * Errors from opening the file image or group are also captured in the returned status.
+ *
+ * @param data Pointer to the file image.
+ * This should remain valid and unmodified for the duration of the call.
+ * @param size Size of the file image in bytes.
+ * @param name Name of the group inside the file.
+ * @param options Validation options, see the `validate()` overload for file images.
+ *
+ * @return Status of the validation, see the `try_validate()` overload for a `H5::Group`.
+ */
+inline ValidationStatus try_validate(const void* data, size_t size, const std::string& name, Options& options) {
+    ValidationStatus output;
+    try {
+        internal_file::ImageBuffer image;
+        auto handle = internal_file::open(data, size, options.file_access, image);
+        auto ghandle = handle.openGroup(name);
+        return try_validate(ghandle, options);
+    } catch (std::exception& e) {
+        output.error = ValidationError(ErrorCode::INVALID, e.what());
+    } catch (H5::Exception& e) {
+        output.error = ValidationError(ErrorCode::HDF5_ERROR, e.getDetailMsg());
+    }
+    return output;
+}
+
+/**
+ * Validate a delayed operation/array in a HDF5 file image with default options, catching any error.
+ *
+ * @param data Pointer to the file image.
+ * This should remain valid and unmodified for the duration of the call.
+ * @param size Size of the file image in bytes.
+ * @param name Name of the group inside the file.
+ *
+ * @return Status of the validation, see the `try_validate()` overload for a `H5::Group`.
+ */
+inline ValidationStatus try_validate(const void* data, size_t size, const std::string& name) {
+    Options options;
+    return try_validate(data, size, name, options);
+}
+
 }
 
 #endif
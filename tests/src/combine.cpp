@@ -60,6 +60,26 @@ TEST_P(CombineTest, Simple) {
     }
 }
 
+TEST_P(CombineTest, Many) {
+    auto version = GetParam();
+
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto ghandle = combine_opener(fhandle, "hello", 0, version);
+        auto lhandle = list_opener(ghandle, "seeds", 150, version);
+        for (size_t i = 0; i < 150; ++i) {
+            mock_array_opener(lhandle, std::to_string(i), { static_cast<int>(i % 7), 19 }, version, (i == 123 ? "FLOAT" : "INTEGER"));
+        }
+    }
+    {
+        auto output = test_validate(path, "hello"); 
+        EXPECT_EQ(output.type, chihaya::FLOAT);
+        const auto& dims = output.dimensions;
+        EXPECT_EQ(dims[0], 444);
+        EXPECT_EQ(dims[1], 19);
+    }
+}
+
 TEST_P(CombineTest, Mixed) {
     auto version = GetParam();
 
@@ -153,6 +173,20 @@ TEST_P(CombineTest, SeedErrors) {
     }
     expect_error(path, "hello", "failed to validate 'seeds/0'");
 
+    // Errors refer to the actual name of the child, even if it is not canonical.
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto ghandle = combine_opener(fhandle, "hello", 0, version);
+        auto lhandle = list_opener(ghandle, "seeds", 1, version);
+        lhandle.createGroup("00");
+    }
+    {
+        auto status = chihaya::try_validate(path, "hello");
+        EXPECT_NE(std::string(status.error.what()).find("failed to validate 'seeds/00'"), std::string::npos);
+        std::vector<std::string> expected_path { "seeds/00" };
+        EXPECT_EQ(status.error.path(), expected_path);
+    }
+
     {
         H5::H5File fhandle(path, H5F_ACC_TRUNC);
         auto ghandle = combine_opener(fhandle, "hello", 0, version);
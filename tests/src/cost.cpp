@@ -0,0 +1,256 @@
+#include <gtest/gtest.h>
+#include "chihaya/chihaya.hpp"
+#include "utils.h"
+
+class CostTest : public ::testing::Test {
+public:
+    CostTest() : path("Test_cost.h5") {}
+
+protected:
+    std::string path;
+
+    // 10 x 5 sparse matrix with 10 non-zero elements.
+    static H5::Group sparse_matrix_opener(const H5::Group& handle, const std::string& name) {
+        auto ghandle = array_opener(handle, name, "sparse matrix");
+        add_version_string(ghandle, 1100000);
+        auto dhandle = add_numeric_vector<double>(ghandle, "data", { -1.10, 0.18, 0.95, -0.17, -0.031, -0.75, 0.13, -0.89, 0.74, -0.43 }, H5::PredType::NATIVE_DOUBLE);
+        add_string_attribute(dhandle, "type", "FLOAT");
+        add_numeric_vector<int>(ghandle, "shape", { 10, 5 }, H5::PredType::NATIVE_UINT32);
+        add_numeric_vector<int>(ghandle, "indices", { 0, 4, 4, 5, 7, 8, 4, 9, 2, 9 }, H5::PredType::NATIVE_UINT32);
+        add_numeric_vector<int>(ghandle, "indptr", { 0, 2, 5, 6, 8, 10 }, H5::PredType::NATIVE_UINT64);
+        add_numeric_scalar(ghandle, "by_column", 1, H5::PredType::NATIVE_INT8);
+        return ghandle;
+    }
+};
+
+TEST_F(CostTest, Sparse) {
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto ghandle = operation_opener(fhandle, "WHEE", "transpose");
+        add_version_string(ghandle, 1100000);
+        add_numeric_vector<int>(ghandle, "permutation", { 1, 0 }, H5::PredType::NATIVE_UINT32);
+
+        auto mhandle = operation_opener(ghandle, "seed", "unary math");
+        add_string_scalar(mhandle, "method", "log1p");
+        sparse_matrix_opener(mhandle, "seed");
+    }
+
+    chihaya::Options options;
+    auto est = chihaya::estimate_cost(path, "WHEE", options);
+    EXPECT_FALSE(options.collect_costs);
+    EXPECT_TRUE(options.node_costs.empty());
+
+    ASSERT_EQ(est.nodes.size(), 3);
+    EXPECT_EQ(est.nodes[0].name, "/WHEE");
+    EXPECT_EQ(est.nodes[0].kind, "transpose");
+    EXPECT_EQ(est.nodes[0].parent, chihaya::NodeCost::no_parent);
+    EXPECT_EQ(est.nodes[1].name, "/WHEE/seed");
+    EXPECT_EQ(est.nodes[1].kind, "unary math");
+    EXPECT_EQ(est.nodes[1].parent, 0);
+    EXPECT_EQ(est.nodes[2].name, "/WHEE/seed/seed");
+    EXPECT_EQ(est.nodes[2].kind, "sparse matrix");
+    EXPECT_EQ(est.nodes[2].parent, 1);
+
+    for (const auto& node : est.nodes) {
+        EXPECT_TRUE(node.sparse);
+        EXPECT_EQ(node.nonzeros, 10);
+    }
+    EXPECT_TRUE(est.sparse);
+
+    std::vector<size_t> expected_dims { 5, 10 };
+    EXPECT_EQ(est.nodes[0].details.dimensions, expected_dims);
+    EXPECT_EQ(est.nodes[0].flops, 0);
+    EXPECT_EQ(est.nodes[1].flops, 10);
+    EXPECT_EQ(est.nodes[2].flops, 0);
+    EXPECT_EQ(est.flops, 10);
+
+    // Child datasets are not counted for the parent.
+    EXPECT_GE(est.nodes[2].stored_bytes, 80 + 40 + 48);
+    EXPECT_LT(est.nodes[0].stored_bytes, 80);
+    EXPECT_GE(est.stored_bytes, est.nodes[0].stored_bytes + est.nodes[1].stored_bytes + est.nodes[2].stored_bytes);
+
+    EXPECT_EQ(est.nodes[2].memory_bytes, 10 * 16 + 6 * 8);
+    EXPECT_EQ(est.nodes[1].peak_memory_bytes, 2 * (10 * 16 + 6 * 8));
+    EXPECT_EQ(est.nodes[0].memory_bytes, 10 * 16 + 11 * 8);
+    EXPECT_EQ(est.peak_memory_bytes, (10 * 16 + 11 * 8) + (10 * 16 + 6 * 8));
+
+    auto message = chihaya::explain(est);
+    EXPECT_EQ(message.rfind("transpose '/WHEE': FLOAT [5 x 10] sparse (10 non-zeros)", 0), 0);
+    EXPECT_NE(message.find("\n  unary math '/WHEE/seed'"), std::string::npos);
+    EXPECT_NE(message.find("\n    sparse matrix '/WHEE/seed/seed'"), std::string::npos);
+    EXPECT_NE(message.find("\ntotal: "), std::string::npos);
+    EXPECT_NE(message.find("sparse result"), std::string::npos);
+
+    // Densifying operations.
+    {
+        H5::H5File fhandle(path, H5F_ACC_RDWR);
+        auto mhandle = fhandle.openGroup("WHEE/seed");
+        mhandle.unlink("method");
+        add_string_scalar(mhandle, "method", "exp");
+    }
+
+    est = chihaya::estimate_cost(path, "WHEE");
+    ASSERT_EQ(est.nodes.size(), 3);
+    EXPECT_FALSE(est.nodes[0].sparse);
+    EXPECT_FALSE(est.nodes[1].sparse);
+    EXPECT_TRUE(est.nodes[2].sparse);
+    EXPECT_EQ(est.nodes[1].flops, 50);
+    EXPECT_EQ(est.nodes[0].memory_bytes, 50 * 8);
+    EXPECT_FALSE(est.sparse);
+}
+
+TEST_F(CostTest, Combine) {
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto ghandle = operation_opener(fhandle, "WHEE", "combine");
+        add_version_string(ghandle, 1100000);
+        add_numeric_scalar(ghandle, "along", 1, H5::PredType::NATIVE_UINT32);
+        auto lhandle = list_opener(ghandle, "seeds", 3, 1100000);
+        sparse_matrix_opener(lhandle, "0");
+        sparse_matrix_opener(lhandle, "1");
+        sparse_matrix_opener(lhandle, "2");
+    }
+
+    auto est = chihaya::estimate_cost(path, "WHEE");
+    ASSERT_EQ(est.nodes.size(), 4);
+    for (size_t i = 1; i < 4; ++i) {
+        EXPECT_EQ(est.nodes[i].parent, 0);
+        EXPECT_EQ(est.nodes[i].name, "/WHEE/seeds/" + std::to_string(i - 1));
+    }
+    EXPECT_TRUE(est.sparse);
+    EXPECT_EQ(est.nodes[0].nonzeros, 30);
+    EXPECT_EQ(est.flops, 0);
+
+    // Replacing one seed with a dense array.
+    {
+        H5::H5File fhandle(path, H5F_ACC_RDWR);
+        auto lhandle = fhandle.openGroup("WHEE/seeds");
+        lhandle.unlink("1");
+        mock_array_opener(lhandle, "1", { 10, 5 }, 1100000, "FLOAT");
+    }
+
+    est = chihaya::estimate_cost(path, "WHEE");
+    EXPECT_FALSE(est.sparse);
+    EXPECT_EQ(est.nodes[0].nonzeros, 150);
+}
+
+TEST_F(CostTest, MatrixProduct) {
+    auto create = [&](bool sparse) -> void {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto ghandle = operation_opener(fhandle, "WHEE", "matrix product");
+        add_version_string(ghandle, 1100000);
+        if (sparse) {
+            sparse_matrix_opener(ghandle, "left_seed");
+        } else {
+            mock_array_opener(ghandle, "left_seed", { 10, 5 }, 1100000, "FLOAT");
+        }
+        add_string_scalar(ghandle, "left_orientation", "N");
+        mock_array_opener(ghandle, "right_seed", { 5, 7 }, 1100000, "FLOAT");
+        add_string_scalar(ghandle, "right_orientation", "N");
+    };
+
+    create(true);
+    auto est = chihaya::estimate_cost(path, "WHEE");
+    ASSERT_EQ(est.nodes.size(), 3);
+    EXPECT_FALSE(est.sparse);
+    EXPECT_EQ(est.flops, 2 * 10 * 7);
+    EXPECT_EQ(est.nodes[0].memory_bytes, 10 * 7 * 8);
+    EXPECT_EQ(est.peak_memory_bytes, 10 * 7 * 8 + (10 * 16 + 6 * 8) + 5 * 7 * 8);
+
+    create(false);
+    est = chihaya::estimate_cost(path, "WHEE");
+    EXPECT_EQ(est.flops, 2 * 10 * 5 * 7);
+}
+
+TEST_F(CostTest, SparseMatrixProduct) {
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto ghandle = operation_opener(fhandle, "WHEE", "matrix product");
+        add_version_string(ghandle, 1100000);
+        sparse_matrix_opener(ghandle, "left_seed");
+        add_string_scalar(ghandle, "left_orientation", "N");
+        sparse_matrix_opener(ghandle, "right_seed");
+        add_string_scalar(ghandle, "right_orientation", "T");
+    }
+
+    auto est = chihaya::estimate_cost(path, "WHEE");
+    ASSERT_EQ(est.nodes.size(), 3);
+    std::vector<size_t> expected_dims { 10, 10 };
+    EXPECT_EQ(est.nodes[0].details.dimensions, expected_dims);
+
+    // Each operand has a density of 0.2 with a common dimension of 5.
+    EXPECT_TRUE(est.sparse);
+    EXPECT_EQ(est.flops, 2.0 * 10 * 10 / 5);
+    EXPECT_EQ(est.nodes[0].nonzeros, 19); // i.e., ceiling of 100 * (1 - (1 - 0.2 * 0.2)^5).
+    EXPECT_EQ(est.nodes[0].memory_bytes, 19 * 16 + 11 * 8);
+    EXPECT_EQ(est.peak_memory_bytes, (19 * 16 + 11 * 8) + 2 * (10 * 16 + 6 * 8));
+
+    // Zero-extent result with a non-zero common dimension.
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto ghandle = operation_opener(fhandle, "WHEE", "matrix product");
+        add_version_string(ghandle, 1100000);
+        sparse_matrix_opener(ghandle, "left_seed");
+        add_string_scalar(ghandle, "left_orientation", "N");
+
+        auto rhandle = array_opener(ghandle, "right_seed", "sparse matrix");
+        add_version_string(rhandle, 1100000);
+        auto dhandle = add_numeric_vector<double>(rhandle, "data", {}, H5::PredType::NATIVE_DOUBLE);
+        add_string_attribute(dhandle, "type", "FLOAT");
+        add_numeric_vector<int>(rhandle, "shape", { 0, 5 }, H5::PredType::NATIVE_UINT32);
+        add_numeric_vector<int>(rhandle, "indices", {}, H5::PredType::NATIVE_UINT32);
+        add_numeric_vector<int>(rhandle, "indptr", { 0, 0, 0, 0, 0, 0 }, H5::PredType::NATIVE_UINT64);
+        add_numeric_scalar(rhandle, "by_column", 1, H5::PredType::NATIVE_INT8);
+        add_string_scalar(ghandle, "right_orientation", "T");
+    }
+
+    est = chihaya::estimate_cost(path, "WHEE");
+    ASSERT_EQ(est.nodes.size(), 3);
+    std::vector<size_t> empty_dims { 10, 0 };
+    EXPECT_EQ(est.nodes[0].details.dimensions, empty_dims);
+    EXPECT_TRUE(est.sparse);
+    EXPECT_EQ(est.flops, 0);
+    EXPECT_EQ(est.nodes[0].nonzeros, 0);
+}
+
+TEST_F(CostTest, Errors) {
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto ghandle = operation_opener(fhandle, "WHEE", "transpose");
+        add_version_string(ghandle, 1100000);
+        add_numeric_vector<int>(ghandle, "permutation", { 1, 1 }, H5::PredType::NATIVE_UINT32);
+        sparse_matrix_opener(ghandle, "seed");
+    }
+
+    chihaya::Options options;
+    expect_error([&]() { chihaya::estimate_cost(path, "WHEE", options); }, "permutation");
+    EXPECT_FALSE(options.collect_costs);
+    EXPECT_TRUE(options.node_costs.empty());
+}
+
+TEST_F(CostTest, NoScans) {
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto ghandle = operation_opener(fhandle, "WHEE", "transpose");
+        add_version_string(ghandle, 1100000);
+        add_numeric_vector<int>(ghandle, "permutation", { 1, 0 }, H5::PredType::NATIVE_UINT32);
+        auto shandle = sparse_matrix_opener(ghandle, "seed");
+        shandle.unlink("indices");
+        add_numeric_vector<int>(shandle, "indices", { 0, 4, 4, 5, 7, 8, 4, 9, 2, 10 }, H5::PredType::NATIVE_UINT32); // last one out of range.
+    }
+    expect_error(path, "WHEE", "indices");
+
+    // Contents are not scanned, and the options are restored afterwards.
+    chihaya::Options options;
+    options.check_data_contents = true;
+    options.collect_sparse_statistics = true;
+    options.deferred_scans.emplace_back();
+    auto est = chihaya::estimate_cost(path, "WHEE", options);
+    EXPECT_EQ(est.nodes.size(), 2);
+    EXPECT_FALSE(options.defer_scans);
+    EXPECT_TRUE(options.check_data_contents);
+    EXPECT_FALSE(options.check_utf8_strings);
+    EXPECT_TRUE(options.collect_sparse_statistics);
+    EXPECT_TRUE(options.sparse_statistics.empty());
+    EXPECT_EQ(options.deferred_scans.size(), 1);
+}
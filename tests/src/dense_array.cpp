@@ -84,6 +84,23 @@ TEST_P(DenseArrayTest, Basic) {
         EXPECT_EQ(dims[1], 4);
         EXPECT_EQ(dims[2], 5);
     }
+
+    // Fixed-length strings are only scanned when checking UTF-8.
+    {
+        H5::H5File fhandle(path, H5F_ACC_RDONLY);
+        auto ghandle = fhandle.openGroup("dense");
+        auto parsed = ritsuko::Version(version / 1000000, (version / 1000) % 1000, version % 1000);
+
+        chihaya::Options options;
+        options.defer_scans = true;
+        chihaya::validate(ghandle, parsed, options);
+        EXPECT_TRUE(options.deferred_scans.empty());
+
+        options.check_utf8_strings = true;
+        chihaya::validate(ghandle, parsed, options);
+        EXPECT_EQ(options.deferred_scans.size(), 1);
+        chihaya::run_deferred_scans(options);
+    }
 }
 
 TEST_P(DenseArrayTest, NonNative) {
@@ -327,6 +344,102 @@ TEST_P(DenseArrayTest, MissingErrors) {
     }
 }
 
+TEST_P(DenseArrayTest, DataContents) {
+    auto version = GetParam();
+    std::vector<hsize_t> dims { 200, 17 };
+    std::vector<int> values(dims[0] * dims[1]);
+    for (size_t i = 0; i < values.size(); ++i) {
+        values[i] = i % 3 == 0;
+    }
+
+    auto create = [&](const std::vector<int>& contents, bool placeholder) -> void {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto ghandle = dense_array_opener(fhandle, "dense", dims, H5::PredType::NATIVE_INT8, version);
+        ghandle.unlink("data");
+
+        H5::DSetCreatPropList cplist;
+        std::vector<hsize_t> chunks { 7, 17 };
+        cplist.setChunk(2, chunks.data());
+        H5::DataSpace dspace(2, dims.data());
+        auto dhandle = ghandle.createDataSet("data", H5::PredType::NATIVE_INT8, dspace, cplist);
+        dhandle.write(contents.data(), H5::PredType::NATIVE_INT);
+
+        if (version < 1100000) {
+            auto ahandle = dhandle.createAttribute("is_boolean", H5::PredType::NATIVE_INT, H5S_SCALAR);
+            int val = 1;
+            ahandle.write(H5::PredType::NATIVE_INT, &val);
+        } else {
+            add_string_attribute(dhandle, "type", "BOOLEAN");
+        }
+        if (placeholder) {
+            add_numeric_missing_placeholder(dhandle, -1, H5::PredType::NATIVE_INT8);
+        }
+    };
+
+    auto check = [&](int threads) -> void {
+        H5::H5File fhandle(path, H5F_ACC_RDONLY);
+        chihaya::Options opts;
+        opts.check_data_contents = true;
+        opts.num_threads = threads;
+        chihaya::validate(fhandle.openGroup("dense"), opts);
+    };
+
+    create(values, false);
+    check(1);
+    check(4);
+
+    auto copy = values;
+    copy[150 * 17 + 3] = 2;
+    create(copy, false);
+    expect_error([&]() { check(1); }, "expected 0 or 1");
+    test_validate(path, "dense"); // not checked by default.
+
+    // Checking blocks in parallel, where the first offending element should be reported.
+    copy[20 * 17] = 5;
+    create(copy, false);
+    {
+        H5::H5File fhandle(path, H5F_ACC_RDONLY);
+        auto dhandle = fhandle.openDataSet("dense/data");
+        chihaya::internal_content::Range range;
+        EXPECT_TRUE(chihaya::internal_content::needs_scan(dhandle, chihaya::BOOLEAN, ritsuko::Version(1, 1, 0), range));
+        try {
+            chihaya::internal_content::scan_dataset(dhandle, dims, range, 3, 50);
+            ADD_FAILURE() << "expected an error";
+        } catch (chihaya::ValidationError& e) {
+            EXPECT_EQ(e.index(), 20 * 17);
+        }
+    }
+
+    if (version >= 1000000) {
+        copy = values;
+        copy[10] = -1;
+        create(copy, true);
+        check(1);
+        check(4);
+    }
+
+    // Integers that are guaranteed to fit do not need to be checked.
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto ghandle = dense_array_opener(fhandle, "dense", { 20, 17 }, H5::PredType::NATIVE_INT32, version);
+        chihaya::internal_content::Range range;
+        EXPECT_FALSE(chihaya::internal_content::needs_scan(ghandle.openDataSet("data"), chihaya::INTEGER, ritsuko::Version(1, 1, 0), range));
+    }
+
+    if (version < 1100000) {
+        {
+            H5::H5File fhandle(path, H5F_ACC_TRUNC);
+            auto ghandle = dense_array_opener(fhandle, "dense", { 20 }, H5::PredType::NATIVE_INT64, version);
+            ghandle.unlink("data");
+            std::vector<int64_t> big(20);
+            big[5] = 10000000000;
+            add_numeric_vector(ghandle, "data", big, H5::PredType::NATIVE_INT64);
+        }
+        test_validate(path, "dense");
+        expect_error([&]() { check(1); }, "32-bit signed integer");
+    }
+}
+
 INSTANTIATE_TEST_SUITE_P(
     DenseArray,
     DenseArrayTest,
@@ -139,6 +139,35 @@ TEST_P(DimnamesTest, Errors) {
         add_string_vector(lhandle, "1", 20, /* len = */ H5T_VARIABLE);
     }
     expect_error(path, "hello", "NULL");
+
+    // Entries are scanned in parallel.
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto ghandle = dimnames_opener(fhandle, "hello", { 10, 20 }, "INTEGER", version);
+        auto lhandle = ghandle.openGroup("dimnames");
+        add_string_vector(lhandle, "0", 10, /* len = */ 3);
+
+        hsize_t n = 20;
+        H5::DataSpace dspace(1, &n);
+        H5::StrType stype(0, 3);
+        std::string contents(60, 'a');
+        contents[35] = '\xff';
+        lhandle.createDataSet("1", stype, dspace).write(contents.data(), stype);
+    }
+    test_validate(path, "hello"); // contents are only checked on request.
+    expect_error([&]() {
+        H5::H5File fhandle(path, H5F_ACC_RDONLY);
+        chihaya::Options opts;
+        opts.check_utf8_strings = true;
+        chihaya::validate(fhandle.openGroup("hello"), opts);
+    }, "UTF-8");
+    expect_error([&]() {
+        H5::H5File fhandle(path, H5F_ACC_RDONLY);
+        chihaya::Options opts;
+        opts.check_utf8_strings = true;
+        opts.num_threads = 2;
+        chihaya::validate(fhandle.openGroup("hello"), opts);
+    }, "UTF-8");
 }
 
 INSTANTIATE_TEST_SUITE_P(
@@ -1,6 +1,9 @@
 #include <gtest/gtest.h>
 #include "chihaya/chihaya.hpp"
 #include "utils.h"
+#include <memory>
+#include <fstream>
+#include <iterator>
 
 class ExternalHdf5Test : public ::testing::TestWithParam<int> {
 public:
@@ -117,6 +120,154 @@ TEST_P(ExternalHdf5Test, Errors) {
     expect_error(path, "ext", "string");
 }
 
+TEST_P(ExternalHdf5Test, Resolve) {
+    auto version = GetParam();
+    if (version >= 1100000) {
+        return;
+    }
+
+    std::string backing = "Test_external_backing.h5";
+    {
+        H5::H5File fhandle(backing, H5F_ACC_TRUNC);
+        auto ghandle = fhandle.createGroup("foo");
+        hsize_t dims[3] = { 10, 5, 50 };
+        ghandle.createDataSet("bar", H5::PredType::NATIVE_DOUBLE, H5::DataSpace(3, dims));
+        ghandle.createDataSet("stuff", H5::PredType::NATIVE_INT, H5::DataSpace(3, dims));
+    }
+
+    auto create = [&](int nseeds, const std::string& name, const std::vector<int>& dimensions, std::string type) -> void {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto ghandle = operation_opener(fhandle, "comb", "combine");
+        add_version_string(ghandle, version);
+        add_numeric_scalar(ghandle, "along", 0, H5::PredType::NATIVE_INT);
+        auto lhandle = list_opener(ghandle, "seeds", nseeds, version);
+        for (int s = 0; s < nseeds; ++s) {
+            auto ehandle = external_array_opener(lhandle, std::to_string(s), dimensions, version, type);
+            ehandle.unlink("file");
+            add_string_scalar(ehandle, "file", backing);
+            ehandle.unlink("name");
+            add_string_scalar(ehandle, "name", name);
+        }
+    };
+
+    chihaya::Options options;
+    options.resolve_external_hdf5 = true;
+
+    create(20, "foo/bar", { 50, 5, 10 }, "FLOAT");
+    {
+        auto output = chihaya::validate(path, "comb", options);
+        EXPECT_EQ(output.dimensions[0], 1000);
+        EXPECT_EQ(options.external_file_pool.size(), 1);
+    }
+
+    create(1, "foo/stuff", { 50, 5, 10 }, "INTEGER");
+    chihaya::validate(path, "comb", options);
+    create(1, "foo/stuff", { 50, 5, 10 }, "FLOAT");
+    chihaya::validate(path, "comb", options);
+
+    // Not checked by default.
+    create(1, "foo/bar", { 50, 5, 10 }, "INTEGER");
+    test_validate(path, "comb");
+    expect_error([&]() { chihaya::validate(path, "comb", options); }, "not consistent with 'type'");
+
+    create(1, "foo/bar", { 50, 10, 5 }, "FLOAT");
+    expect_error([&]() { chihaya::validate(path, "comb", options); }, "should be equal to 'dimensions'");
+
+    create(1, "foo/bar", { 50, 5 }, "FLOAT");
+    expect_error([&]() { chihaya::validate(path, "comb", options); }, "dimensionality of the external dataset");
+
+    create(1, "foo/missing", { 50, 5, 10 }, "FLOAT");
+    expect_error([&]() { chihaya::validate(path, "comb", options); }, "failed to open dataset 'foo/missing'");
+
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto ehandle = external_array_opener(fhandle, "ext", { 50, 5, 10 }, version, "FLOAT");
+        ehandle.unlink("file");
+        add_string_scalar(ehandle, "file", "missing.h5");
+    }
+    expect_error([&]() { chihaya::validate(path, "ext", options); }, "in external file 'missing.h5'");
+
+    // Relative paths in file images can only be resolved against an explicit directory.
+    create(1, "foo/bar", { 50, 5, 10 }, "FLOAT");
+    std::vector<char> image;
+    {
+        std::ifstream input(path, std::ios::binary);
+        image.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+    }
+    expect_error([&]() { chihaya::validate(image.data(), image.size(), "comb", options); }, "cannot resolve relative path");
+
+    options.external_hdf5_directory = ".";
+    chihaya::validate(image.data(), image.size(), "comb", options);
+    chihaya::validate(path, "comb", options);
+
+    options.external_file_pool.clear();
+    options.external_hdf5_directory = "missing_directory";
+    expect_error([&]() { chihaya::validate(path, "comb", options); }, "in external file 'missing_directory/");
+}
+
+TEST(ExternalFilePool, Basic) {
+    std::vector<std::string> paths;
+    for (int i = 0; i < 3; ++i) {
+        paths.push_back("Test_external_pool" + std::to_string(i) + ".h5");
+        H5::H5File fhandle(paths.back(), H5F_ACC_TRUNC);
+        fhandle.createGroup("group" + std::to_string(i));
+    }
+
+    chihaya::ExternalFilePool pool(2);
+    EXPECT_EQ(pool.open(paths[0]).getObjnameByIdx(0), "group0");
+    EXPECT_EQ(pool.open(paths[1]).getObjnameByIdx(0), "group1");
+    EXPECT_EQ(pool.size(), 2);
+
+    // Evicts the least recently used file.
+    pool.open(paths[0]);
+    EXPECT_EQ(pool.open(paths[2]).getObjnameByIdx(0), "group2");
+    EXPECT_EQ(pool.size(), 2);
+    EXPECT_EQ(pool.open(paths[0]).getObjnameByIdx(0), "group0");
+    EXPECT_EQ(pool.open(paths[1]).getObjnameByIdx(0), "group1");
+    EXPECT_EQ(pool.size(), 2);
+
+    pool.clear();
+    EXPECT_EQ(pool.size(), 0);
+
+    chihaya::ExternalFilePool empty(0);
+    EXPECT_EQ(empty.open(paths[2]).getObjnameByIdx(0), "group2");
+    EXPECT_EQ(empty.size(), 0);
+}
+
+TEST(ExternalFilePool, Copy) {
+    std::vector<std::string> paths;
+    for (int i = 0; i < 3; ++i) {
+        paths.push_back("Test_external_pool" + std::to_string(i) + ".h5");
+        H5::H5File fhandle(paths.back(), H5F_ACC_TRUNC);
+        fhandle.createGroup("group" + std::to_string(i));
+    }
+
+    std::unique_ptr<chihaya::ExternalFilePool> original(new chihaya::ExternalFilePool(2));
+    original->open(paths[0]);
+    original->open(paths[1]);
+
+    // Copies must not refer to the original's files once it is gone.
+    chihaya::ExternalFilePool copy(*original);
+    chihaya::ExternalFilePool assigned;
+    assigned = *original;
+    original.reset();
+
+    for (auto* pool : { &copy, &assigned }) {
+        EXPECT_EQ(pool->size(), 2);
+        EXPECT_EQ(pool->open(paths[0]).getObjnameByIdx(0), "group0");
+        EXPECT_EQ(pool->open(paths[2]).getObjnameByIdx(0), "group2"); // evicts paths[1].
+        EXPECT_EQ(pool->size(), 2);
+        EXPECT_EQ(pool->open(paths[0]).getObjnameByIdx(0), "group0");
+        EXPECT_EQ(pool->size(), 2);
+    }
+
+    chihaya::ExternalFilePool moved(std::move(copy));
+    EXPECT_EQ(moved.size(), 2);
+    EXPECT_EQ(moved.open(paths[1]).getObjnameByIdx(0), "group1"); // evicts paths[2].
+    EXPECT_EQ(moved.open(paths[0]).getObjnameByIdx(0), "group0");
+    EXPECT_EQ(moved.size(), 2);
+}
+
 INSTANTIATE_TEST_SUITE_P(
     ExternalHdf5,
     ExternalHdf5Test,
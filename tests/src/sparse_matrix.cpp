@@ -2,6 +2,9 @@
 #include "chihaya/chihaya.hpp"
 #include "utils.h"
 
+#include <limits>
+#include <numeric>
+
 class SparseMatrixTest : public ::testing::TestWithParam<int> {
 public:
     SparseMatrixTest() : path("Test_sparse_matrix.h5"), nr(10), nc(5) {
@@ -299,6 +302,22 @@ TEST_P(SparseMatrixTest, IndptrErrors) {
         add_numeric_vector<int>(ghandle, "indptr", copy, H5::PredType::NATIVE_UINT32);
     }
     expect_error(path, "foobar", "sorted");
+
+    // Pointers past the end of 'indices' are caught before the next pointer is compared.
+    {
+        H5::H5File fhandle(path, H5F_ACC_RDWR);
+        auto ghandle = fhandle.openGroup("foobar");
+        ghandle.unlink("indptr");
+        auto copy = indptr;
+        copy[1] = 100;
+        add_numeric_vector<int>(ghandle, "indptr", copy, H5::PredType::NATIVE_UINT32);
+
+        ghandle.unlink("indices");
+        std::vector<int> sorted(indices.size());
+        std::iota(sorted.begin(), sorted.end(), 0);
+        add_numeric_vector<int>(ghandle, "indices", sorted, (version < 1100000 ? H5::PredType::NATIVE_INT : H5::PredType::NATIVE_UINT32));
+    }
+    expect_error(path, "foobar", "beyond the end");
 }
 
 TEST_P(SparseMatrixTest, ComplexIndexErrors) {
@@ -337,6 +356,152 @@ TEST_P(SparseMatrixTest, ComplexIndexErrors) {
     expect_error(path, "foobar", "strictly increasing");
 }
 
+TEST_P(SparseMatrixTest, IndexWidths) {
+    auto version = GetParam();
+
+    std::vector<H5::PredType> types { H5::PredType::NATIVE_UINT8, H5::PredType::NATIVE_UINT16, H5::PredType::NATIVE_UINT32, H5::PredType::NATIVE_UINT64 };
+    for (const auto& t : types) {
+        {
+            H5::H5File fhandle(path, H5F_ACC_TRUNC);
+            auto ghandle = sparse_matrix_opener(fhandle, version);
+            ghandle.unlink("indices");
+            add_numeric_vector<int>(ghandle, "indices", indices, t);
+        }
+        auto output = test_validate(path, "foobar"); 
+        EXPECT_EQ(output.dimensions[0], nr);
+
+        {
+            H5::H5File fhandle(path, H5F_ACC_RDWR);
+            auto ghandle = fhandle.openGroup("foobar");
+            ghandle.unlink("indices");
+            auto copy = indices;
+            copy[1] = 255; 
+            add_numeric_vector<int>(ghandle, "indices", copy, t);
+        }
+        expect_error(path, "foobar", "number of rows");
+    }
+}
+
+TEST_P(SparseMatrixTest, Statistics) {
+    auto version = GetParam();
+
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto copy = data;
+        copy[3] = 2.5;
+        copy[5] = std::numeric_limits<double>::quiet_NaN();
+        std::swap(data, copy);
+        auto ghandle = sparse_matrix_opener(fhandle, version);
+        std::swap(data, copy);
+        if (version >= 1000000) {
+            add_numeric_missing_placeholder(ghandle.openDataSet("data"), 2.5, H5::PredType::NATIVE_DOUBLE);
+        }
+    }
+
+    {
+        H5::H5File fhandle(path, H5F_ACC_RDONLY);
+        auto ghandle = fhandle.openGroup("foobar");
+
+        for (int threads = 1; threads <= 2; ++threads) {
+            chihaya::Options opts;
+            opts.collect_sparse_statistics = true;
+            opts.defer_scans = (threads > 1);
+            opts.num_threads = threads;
+            chihaya::validate(ghandle, opts);
+
+            ASSERT_EQ(opts.sparse_statistics.size(), 1);
+            const auto& stats = opts.sparse_statistics.front();
+            EXPECT_EQ(stats.name, "/foobar");
+            EXPECT_EQ(stats.column_nonzeros, std::vector<uint64_t>({ 2, 3, 1, 2, 2 }));
+            EXPECT_EQ(stats.row_nonzeros, std::vector<uint64_t>({ 1, 0, 1, 0, 3, 1, 0, 1, 1, 2 }));
+            EXPECT_EQ(stats.minimum, -1.10);
+            EXPECT_EQ(stats.nan_count, 1);
+
+            if (version >= 1000000) {
+                EXPECT_EQ(stats.maximum, 0.95);
+                EXPECT_EQ(stats.placeholder_count, 1);
+            } else {
+                EXPECT_EQ(stats.maximum, 2.5);
+                EXPECT_EQ(stats.placeholder_count, 0);
+            }
+
+            // Missing values do not contribute to the sums.
+            std::vector<double> colsums { -1.10 + 0.18, 0.95 - 0.031, 0, 0.13 - 0.89, 0.74 - 0.43 };
+            std::vector<double> colsumsq { 1.10 * 1.10 + 0.18 * 0.18, 0.95 * 0.95 + 0.031 * 0.031, 0, 0.13 * 0.13 + 0.89 * 0.89, 0.74 * 0.74 + 0.43 * 0.43 };
+            std::vector<double> rowsums { -1.10, 0, 0.74, 0, 0.18 + 0.95 + 0.13, 0, 0, -0.031, 0, -0.89 - 0.43 };
+            std::vector<double> rowsumsq { 1.10 * 1.10, 0, 0.74 * 0.74, 0, 0.18 * 0.18 + 0.95 * 0.95 + 0.13 * 0.13, 0, 0, 0.031 * 0.031, 0, 0.89 * 0.89 + 0.43 * 0.43 };
+            if (version < 1000000) {
+                colsums[1] += 2.5;
+                colsumsq[1] += 2.5 * 2.5;
+                rowsums[5] += 2.5;
+                rowsumsq[5] += 2.5 * 2.5;
+            }
+
+            ASSERT_EQ(stats.column_sums.size(), 5);
+            ASSERT_EQ(stats.column_sums_of_squares.size(), 5);
+            for (size_t c = 0; c < 5; ++c) {
+                EXPECT_NEAR(stats.column_sums[c], colsums[c], 1e-8);
+                EXPECT_NEAR(stats.column_sums_of_squares[c], colsumsq[c], 1e-8);
+            }
+
+            ASSERT_EQ(stats.row_sums.size(), 10);
+            ASSERT_EQ(stats.row_sums_of_squares.size(), 10);
+            for (size_t r = 0; r < 10; ++r) {
+                EXPECT_NEAR(stats.row_sums[r], rowsums[r], 1e-8);
+                EXPECT_NEAR(stats.row_sums_of_squares[r], rowsumsq[r], 1e-8);
+            }
+        }
+
+        // Statistics are not collected by default.
+        chihaya::Options opts;
+        chihaya::validate(ghandle, opts);
+        EXPECT_TRUE(opts.sparse_statistics.empty());
+    }
+
+    // Index errors are still reported.
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto ghandle = sparse_matrix_opener(fhandle, version);
+        ghandle.unlink("indices");
+        auto copy = indices;
+        copy[1] = 0;
+        add_numeric_vector(ghandle, "indices", copy, H5::PredType::NATIVE_UINT32);
+    }
+    expect_error([&]() {
+        H5::H5File fhandle(path, H5F_ACC_RDONLY);
+        chihaya::Options opts;
+        opts.collect_sparse_statistics = true;
+        chihaya::validate(fhandle.openGroup("foobar"), opts);
+    }, "strictly increasing");
+}
+
+TEST_P(SparseMatrixTest, DataContents) {
+    auto version = GetParam();
+
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto ghandle = sparse_matrix_opener(fhandle, version);
+        ghandle.unlink("data");
+        std::vector<int> contents { 1, 0, 1, 1, 0, 3, 1, 0, 1, 1 };
+        auto dhandle = add_numeric_vector(ghandle, "data", contents, H5::PredType::NATIVE_INT8);
+        if (version < 1100000) {
+            auto ahandle = dhandle.createAttribute("is_boolean", H5::PredType::NATIVE_INT, H5S_SCALAR);
+            int val = 1;
+            ahandle.write(H5::PredType::NATIVE_INT, &val);
+        } else {
+            add_string_attribute(dhandle, "type", "BOOLEAN");
+        }
+    }
+
+    test_validate(path, "foobar");
+    expect_error([&]() {
+        H5::H5File fhandle(path, H5F_ACC_RDONLY);
+        chihaya::Options opts;
+        opts.check_data_contents = true;
+        chihaya::validate(fhandle.openGroup("foobar"), opts);
+    }, "expected 0 or 1");
+}
+
 TEST_P(SparseMatrixTest, MissingErrors) {
     auto version = GetParam();
 
@@ -156,6 +156,32 @@ TEST_P(SubsetTest, Errors) {
     expect_error(path, "hello", "indices out of range");
 }
 
+TEST_P(SubsetTest, IndexWidths) {
+    auto version = GetParam();
+
+    std::vector<H5::PredType> types { H5::PredType::NATIVE_UINT8, H5::PredType::NATIVE_UINT16, H5::PredType::NATIVE_UINT32, H5::PredType::NATIVE_UINT64 };
+    for (const auto& t : types) {
+        {
+            H5::H5File fhandle(path, H5F_ACC_TRUNC);
+            auto ghandle = subset_opener(fhandle, "hello", { 13, 300 }, version, "INTEGER");
+            auto lhandle = list_opener(ghandle, "index", 2, version);
+            add_numeric_vector<int>(lhandle, "0", { 1, 12, 0 }, t);
+            add_numeric_vector<int>(lhandle, "1", { 255, 0, 10, 3 }, t);
+        }
+        auto output = test_validate(path, "hello"); 
+        EXPECT_EQ(output.dimensions[0], 3);
+        EXPECT_EQ(output.dimensions[1], 4);
+
+        {
+            H5::H5File fhandle(path, H5F_ACC_RDWR);
+            auto lhandle = fhandle.openGroup("hello/index");
+            lhandle.unlink("0");
+            add_numeric_vector<int>(lhandle, "0", { 1, 13, 0 }, t);
+        }
+        expect_error(path, "hello", "indices out of range");
+    }
+}
+
 INSTANTIATE_TEST_SUITE_P(
     Subset,
     SubsetTest,
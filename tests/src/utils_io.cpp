@@ -0,0 +1,42 @@
+#include <gtest/gtest.h>
+#include "chihaya/utils_io.hpp"
+#include "utils.h"
+
+#include <thread>
+#include <vector>
+
+TEST(UtilsIo, Service) {
+    chihaya::internal_io::Service service;
+    auto main_id = std::this_thread::get_id();
+
+    // Requests are executed on the service thread.
+    auto service_id = service.run([]() -> std::thread::id { return std::this_thread::get_id(); });
+    EXPECT_NE(service_id, main_id);
+
+    std::vector<std::future<int> > futures;
+    for (int i = 0; i < 10; ++i) {
+        futures.push_back(service.submit([i]() -> int { return i * 2; }));
+    }
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_EQ(futures[i].get(), i * 2);
+    }
+
+    expect_error([&]() { service.run([]() -> void { throw std::runtime_error("foobar"); }); }, "foobar");
+}
+
+TEST(UtilsIo, Serialize) {
+    // Without a service, the function is called directly.
+    EXPECT_EQ(chihaya::internal_io::serialize([]() -> std::thread::id { return std::this_thread::get_id(); }), std::this_thread::get_id());
+
+    chihaya::internal_io::Service service;
+    auto service_id = service.run([]() -> std::thread::id { return std::this_thread::get_id(); });
+
+    std::thread worker([&]() -> void {
+        chihaya::internal_io::current_service() = &service;
+        EXPECT_EQ(chihaya::internal_io::serialize([]() -> std::thread::id { return std::this_thread::get_id(); }), service_id);
+        chihaya::internal_io::current_service() = NULL;
+    });
+    worker.join();
+
+    EXPECT_TRUE(chihaya::internal_io::current_service() == NULL);
+}
@@ -48,12 +48,9 @@ TEST_P(UtilsListTest, Basic) {
         auto ghandle = fhandle.openGroup("x52");
         auto deets = chihaya::internal_list::validate(ghandle, version);
         EXPECT_EQ(deets.length, 4);
-        EXPECT_EQ(deets.present.size(), 2);
-
-        EXPECT_TRUE(deets.present.find(0) != deets.present.end());
-        EXPECT_EQ(deets.present[0], "0");
-        EXPECT_TRUE(deets.present.find(3) != deets.present.end());
-        EXPECT_EQ(deets.present[3], "3");
+        ASSERT_EQ(deets.present.size(), 2);
+        EXPECT_EQ(deets.present[0].index, 0);
+        EXPECT_EQ(deets.present[1].index, 3);
     }
 
     // Loading the file (partial).
@@ -68,11 +65,9 @@ TEST_P(UtilsListTest, Basic) {
         auto ghandle = fhandle.openGroup("x52");
         auto deets = chihaya::internal_list::validate(ghandle, version);
         EXPECT_EQ(deets.length, 4);
-        EXPECT_EQ(deets.present.size(), 4);
-
+        ASSERT_EQ(deets.present.size(), 4);
         for (size_t i = 0; i < 4; ++i) {
-            EXPECT_TRUE(deets.present.find(i) != deets.present.end());
-            EXPECT_EQ(deets.present[i], std::to_string(i));
+            EXPECT_EQ(deets.present[i].index, i);
         }
     }
 
@@ -89,7 +84,46 @@ TEST_P(UtilsListTest, Basic) {
         auto ghandle = fhandle.openGroup("x52");
         auto deets = chihaya::internal_list::validate(ghandle, version);
         EXPECT_EQ(deets.length, 20);
-        EXPECT_EQ(deets.present.size(), 3);
+        ASSERT_EQ(deets.present.size(), 3);
+
+        // Sorted by index, not by name.
+        EXPECT_EQ(deets.present[0].index, 9);
+        EXPECT_EQ(deets.present[1].index, 11);
+        EXPECT_EQ(deets.present[2].index, 16);
+    }
+}
+
+TEST_P(UtilsListTest, Opening) {
+    auto raw_version = GetParam();
+    auto version = convert_from_int(raw_version);
+
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto lhandle = list_opener(fhandle, "foo", 12, raw_version);
+        for (size_t i = 0; i < 11; ++i) {
+            auto ghandle = lhandle.createGroup(std::to_string(i));
+            add_string_attribute(ghandle, "whee", std::to_string(i * 10));
+        }
+        lhandle.link(H5L_TYPE_SOFT, "/foo/3", "11");
+    }
+
+    {
+        H5::H5File fhandle(path, H5F_ACC_RDONLY);
+        auto ghandle = fhandle.openGroup("foo");
+        auto deets = chihaya::internal_list::validate(ghandle, version);
+        ASSERT_EQ(deets.present.size(), 12);
+
+        for (size_t i = 0; i < 12; ++i) {
+            EXPECT_EQ(deets.present[i].index, i);
+            auto current = chihaya::internal_list::open_group(ghandle, deets.present[i]);
+            auto expected = (i == 11 ? 30 : i * 10);
+            EXPECT_EQ(ritsuko::hdf5::open_and_load_scalar_string_attribute(current, "whee"), std::to_string(expected));
+        }
+
+        EXPECT_FALSE(deets.present[0].hard == deets.present[11].hard);
+        expect_error([&]() -> void { 
+            chihaya::internal_list::open_dataset(ghandle, deets.present[0]);
+        }, "expected a dataset");
     }
 }
 
@@ -211,6 +245,27 @@ TEST_P(UtilsListTest, ElementErrors) {
         H5::H5File fhandle(path, H5F_ACC_RDONLY);
         chihaya::internal_list::validate(fhandle.openGroup("foo"), version);
     }, "out of range");
+
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto lhandle = list_opener(fhandle, "foo", 1, raw_version);
+        lhandle.createGroup("99999999999999999999999");
+    }
+    expect_error([&]() -> void { 
+        H5::H5File fhandle(path, H5F_ACC_RDONLY);
+        chihaya::internal_list::validate(fhandle.openGroup("foo"), version);
+    }, "out of range");
+
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto lhandle = list_opener(fhandle, "foo", 2, raw_version);
+        lhandle.createGroup("1");
+        lhandle.createGroup("01");
+    }
+    expect_error([&]() -> void { 
+        H5::H5File fhandle(path, H5F_ACC_RDONLY);
+        chihaya::internal_list::validate(fhandle.openGroup("foo"), version);
+    }, "multiple objects");
 }
 
 INSTANTIATE_TEST_SUITE_P(
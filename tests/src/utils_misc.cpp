@@ -125,3 +125,37 @@ TEST(UtilsMisc, LoadScalarStringDataset) {
         EXPECT_EQ(chihaya::internal_misc::load_scalar_string_dataset(fhandle, "foo"), "bar");
     }
 }
+
+TEST(UtilsMisc, RethrowWithContext) {
+    chihaya::ValidationError err;
+    try {
+        try {
+            try {
+                throw std::runtime_error("oops");
+            } catch (std::exception& e) {
+                chihaya::internal_misc::rethrow_with_context(e, "failed to validate '", "value", "'", "value");
+            }
+        } catch (std::exception& e) {
+            chihaya::internal_misc::rethrow_with_context(e, "failed to validate the 'dimnames'", "dimnames");
+        }
+    } catch (chihaya::ValidationError& e) {
+        err = e;
+    }
+
+    EXPECT_EQ(err.code(), chihaya::ErrorCode::INVALID);
+    std::vector<std::string> expected_path { "dimnames", "value" };
+    EXPECT_EQ(err.path(), expected_path);
+    EXPECT_EQ(std::string(err.what()), "failed to validate the 'dimnames'; failed to validate 'value'; oops");
+
+    // Eagerly concatenated descriptions give the same message.
+    err.add_context("failed to validate delayed array of type 'dense array'");
+    EXPECT_EQ(std::string(err.what()), "failed to validate delayed array of type 'dense array'; failed to validate the 'dimnames'; failed to validate 'value'; oops");
+    EXPECT_EQ(err.path(), expected_path);
+
+    // Existing handlers for std::runtime_error still match and get the full message.
+    try {
+        throw err;
+    } catch (std::runtime_error& e) {
+        EXPECT_EQ(std::string(e.what()), std::string(err.what()));
+    }
+}
@@ -0,0 +1,281 @@
+#include <gtest/gtest.h>
+#include "chihaya/utils_stream.hpp"
+#include "utils.h"
+
+#include <numeric>
+#include <cstdio>
+#include <type_traits>
+
+TEST(UtilsStream, MappedDataset) {
+    const char* path = "Test_utils_stream.h5";
+
+    std::vector<int> values(1000);
+    std::iota(values.begin(), values.end(), 0);
+
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        add_numeric_vector(fhandle, "contiguous", values, H5::PredType::NATIVE_UINT16);
+
+        hsize_t n = values.size(), chunk = 100;
+        H5::DSetCreatPropList cplist;
+        cplist.setChunk(1, &chunk);
+        cplist.setDeflate(6);
+        H5::DataSpace dspace(1, &n);
+        auto dhandle = fhandle.createDataSet("chunked", H5::PredType::NATIVE_UINT16, dspace, cplist);
+        dhandle.write(values.data(), H5::PredType::NATIVE_INT);
+    }
+
+    auto collect = [&](const H5::DataSet& handle) -> std::vector<int> {
+        std::vector<int> output;
+        chihaya::internal_stream::stream_1d_numeric_dataset<uint16_t>(handle, values.size(), 128, 1, [&](auto& stream) -> void {
+            for (size_t i = 0; i < values.size(); ++i, stream.next()) {
+                output.push_back(stream.get());
+            }
+        });
+        return output;
+    };
+
+    {
+        H5::H5File fhandle(path, H5F_ACC_RDONLY);
+
+        auto chandle = fhandle.openDataSet("contiguous");
+        chihaya::internal_stream::MappedDataset mapped(chandle, H5::PredType::NATIVE_UINT16, values.size());
+#ifdef CHIHAYA_USE_MMAP
+        EXPECT_TRUE(mapped.data() != NULL);
+#endif
+        EXPECT_EQ(collect(chandle), values);
+
+        // Reading past the end of the mapping is an error, not an out-of-bounds access.
+        chihaya::internal_stream::stream_1d_numeric_dataset<uint16_t>(chandle, values.size(), 128, 1, [&](auto& stream) -> void {
+            stream.next(values.size() - 1);
+            EXPECT_EQ(stream.get(), values.back());
+            stream.next();
+            expect_error([&]() { stream.get(); }, "beyond the end");
+        });
+
+        // Type mismatches and filtered datasets are not mapped.
+        chihaya::internal_stream::MappedDataset mismatched(chandle, H5::PredType::NATIVE_UINT32, values.size());
+        EXPECT_TRUE(mismatched.data() == NULL);
+
+        auto khandle = fhandle.openDataSet("chunked");
+        chihaya::internal_stream::MappedDataset kmapped(khandle, H5::PredType::NATIVE_UINT16, values.size());
+        EXPECT_TRUE(kmapped.data() == NULL);
+        EXPECT_EQ(collect(khandle), values);
+    }
+
+    // Files opened for writing are not mapped.
+    {
+        H5::H5File fhandle(path, H5F_ACC_RDWR);
+        auto chandle = fhandle.openDataSet("contiguous");
+        chihaya::internal_stream::MappedDataset mapped(chandle, H5::PredType::NATIVE_UINT16, values.size());
+        EXPECT_TRUE(mapped.data() == NULL);
+        EXPECT_EQ(collect(chandle), values);
+    }
+}
+
+TEST(UtilsStream, MappedUserblock) {
+    const char* path = "Test_utils_stream.h5";
+
+    std::vector<int> values(5000);
+    for (size_t i = 0; i < values.size(); ++i) {
+        values[i] = (i * 17) % 60000;
+    }
+
+    {
+        H5::FileCreatPropList cplist;
+        cplist.setUserblock(512);
+        H5::H5File fhandle(path, H5F_ACC_TRUNC, cplist);
+        add_numeric_vector(fhandle, "contiguous", values, H5::PredType::NATIVE_UINT16);
+    }
+
+    H5::H5File fhandle(path, H5F_ACC_RDONLY);
+    auto chandle = fhandle.openDataSet("contiguous");
+    chihaya::internal_stream::MappedDataset mapped(chandle, H5::PredType::NATIVE_UINT16, values.size());
+#ifdef CHIHAYA_USE_MMAP
+    ASSERT_TRUE(mapped.data() != NULL);
+#endif
+
+    std::vector<int> output;
+    chihaya::internal_stream::stream_1d_numeric_dataset<uint16_t>(chandle, values.size(), 128, 1, [&](auto& stream) -> void {
+        for (size_t i = 0; i < values.size(); ++i, stream.next()) {
+            output.push_back(stream.get());
+        }
+    });
+    EXPECT_EQ(output, values);
+}
+
+TEST(UtilsStream, MappedReplaced) {
+    const char* path = "Test_utils_stream.h5";
+    const char* moved = "Test_utils_stream_moved.h5";
+
+    std::vector<int> values(5000);
+    std::iota(values.begin(), values.end(), 0);
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        add_numeric_vector(fhandle, "contiguous", values, H5::PredType::NATIVE_UINT16);
+    }
+
+    // Replacing the file at the same path after opening should not affect the mapping.
+    H5::H5File fhandle(path, H5F_ACC_RDONLY);
+    auto chandle = fhandle.openDataSet("contiguous");
+    std::rename(path, moved);
+    {
+        std::vector<int> replacement(values.size(), 1);
+        H5::H5File fhandle2(path, H5F_ACC_TRUNC);
+        add_numeric_vector(fhandle2, "contiguous", replacement, H5::PredType::NATIVE_UINT16);
+    }
+
+    chihaya::internal_stream::MappedDataset mapped(chandle, H5::PredType::NATIVE_UINT16, values.size());
+#ifdef CHIHAYA_USE_MMAP
+    ASSERT_TRUE(mapped.data() != NULL);
+#endif
+
+    std::vector<int> output;
+    chihaya::internal_stream::stream_1d_numeric_dataset<uint16_t>(chandle, values.size(), 128, 1, [&](auto& stream) -> void {
+        for (size_t i = 0; i < values.size(); ++i, stream.next()) {
+            output.push_back(stream.get());
+        }
+    });
+    EXPECT_EQ(output, values);
+    std::remove(moved);
+}
+
+TEST(UtilsStream, Prefetch) {
+    const char* path = "Test_utils_stream.h5";
+
+    std::vector<int> values(10000);
+    for (size_t i = 0; i < values.size(); ++i) {
+        values[i] = (i * 7) % 1000;
+    }
+
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        hsize_t n = values.size(), chunk = 100;
+        H5::DSetCreatPropList cplist;
+        cplist.setChunk(1, &chunk);
+        cplist.setDeflate(6);
+        H5::DataSpace dspace(1, &n);
+        auto dhandle = fhandle.createDataSet("chunked", H5::PredType::NATIVE_UINT16, dspace, cplist);
+        dhandle.write(values.data(), H5::PredType::NATIVE_INT);
+    }
+
+    H5::H5File fhandle(path, H5F_ACC_RDONLY);
+    auto dhandle = fhandle.openDataSet("chunked");
+
+    // Trying a variety of buffer sizes, including those that are not multiples of the chunk size.
+    chihaya::internal_io::Service service;
+    for (hsize_t bufsize : { 100, 250, 1000, 9999 }) {
+        chihaya::internal_stream::PrefetchStream1dNumericDataset<int> stream(&dhandle, values.size(), bufsize, service);
+        std::vector<int> output;
+        for (size_t i = 0; i < values.size(); ++i, stream.next()) {
+            output.push_back(stream.get());
+        }
+        EXPECT_EQ(output, values);
+        expect_error([&]() { stream.get(); }, "beyond the end");
+    }
+
+    // Skipping through the stream.
+    {
+        chihaya::internal_stream::PrefetchStream1dNumericDataset<int> stream(&dhandle, values.size(), 100, service);
+        for (size_t i = 0; i < values.size(); i += 33, stream.next(33)) {
+            EXPECT_EQ(stream.get(), values[i]);
+        }
+    }
+
+    // Abandoning the stream early, as would happen when an error is thrown.
+    {
+        chihaya::internal_stream::PrefetchStream1dNumericDataset<int> stream(&dhandle, values.size(), 100, service);
+        EXPECT_EQ(stream.get(), values[0]);
+    }
+}
+
+TEST(UtilsStream, Chunked) {
+    const char* path = "Test_utils_stream.h5";
+
+    std::vector<int> values(10050);
+    for (size_t i = 0; i < values.size(); ++i) {
+        values[i] = (i * 13) % 2000;
+    }
+
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        hsize_t n = values.size(), chunk = 100;
+        H5::DSetCreatPropList cplist;
+        cplist.setChunk(1, &chunk);
+        cplist.setShuffle();
+        cplist.setDeflate(6);
+        H5::DataSpace dspace(1, &n);
+        fhandle.createDataSet("shuffled", H5::PredType::NATIVE_UINT32, dspace, cplist).write(values.data(), H5::PredType::NATIVE_INT);
+
+        H5::DSetCreatPropList cplist2;
+        cplist2.setChunk(1, &chunk);
+        cplist2.setDeflate(6);
+        fhandle.createDataSet("deflated", H5::PredType::NATIVE_UINT32, dspace, cplist2).write(values.data(), H5::PredType::NATIVE_INT);
+
+        H5::DSetCreatPropList cplist3;
+        cplist3.setChunk(1, &chunk);
+        cplist3.setFletcher32();
+        fhandle.createDataSet("checksummed", H5::PredType::NATIVE_UINT32, dspace, cplist3).write(values.data(), H5::PredType::NATIVE_INT);
+    }
+
+    H5::H5File fhandle(path, H5F_ACC_RDONLY);
+
+    for (auto name : { "shuffled", "deflated" }) {
+        auto dhandle = fhandle.openDataSet(name);
+        auto layout = chihaya::internal_chunk::inspect(dhandle, H5::PredType::NATIVE_UINT32, values.size());
+#ifdef CHIHAYA_USE_DIRECT_CHUNKS
+        EXPECT_TRUE(layout.supported);
+        EXPECT_EQ(layout.chunk_length, 100);
+#endif
+        if (!layout.supported) {
+            continue;
+        }
+
+        // Decompressing in the caller.
+        {
+            chihaya::internal_io::Service service;
+            chihaya::internal_stream::ChunkedStream1dNumericDataset<uint32_t> stream(&dhandle, values.size(), layout, service, NULL);
+            std::vector<int> output;
+            for (size_t i = 0; i < values.size(); ++i, stream.next()) {
+                output.push_back(stream.get());
+            }
+            EXPECT_EQ(output, values);
+            expect_error([&]() { stream.get(); }, "beyond the end");
+        }
+
+        // Decompressing in a pool, and abandoning the stream early.
+        {
+            chihaya::internal_io::Service service;
+            std::vector<std::unique_ptr<chihaya::internal_io::Service> > pool;
+            for (int t = 0; t < 3; ++t) {
+                pool.emplace_back(new chihaya::internal_io::Service);
+            }
+            chihaya::internal_stream::ChunkedStream1dNumericDataset<uint32_t> stream(&dhandle, 5000, layout, service, &pool);
+            for (size_t i = 0; i < 5000; i += 33, stream.next(33)) {
+                EXPECT_EQ(stream.get(), values[i]);
+            }
+
+            chihaya::internal_stream::ChunkedStream1dNumericDataset<uint32_t> stream2(&dhandle, values.size(), layout, service, &pool);
+            EXPECT_EQ(stream2.get(), values[0]);
+        }
+
+        // Same results via the dispatch, which only decompresses outside of HDF5 with multiple threads.
+        for (int nthreads : { 1, 4 }) {
+            chihaya::internal_stream::stream_1d_numeric_dataset<uint32_t>(dhandle, values.size(), 1000, nthreads, [&](auto& stream) -> void {
+                bool chunked = std::is_same<typename std::decay<decltype(stream)>::type, chihaya::internal_stream::ChunkedStream1dNumericDataset<uint32_t> >::value;
+                EXPECT_EQ(chunked, nthreads > 1);
+                for (size_t i = 0; i < values.size(); ++i, stream.next()) {
+                    EXPECT_EQ(stream.get(), values[i]);
+                }
+            });
+        }
+    }
+
+    // Unsupported filters and type mismatches fall back to the usual reads.
+    {
+        auto dhandle = fhandle.openDataSet("checksummed");
+        EXPECT_FALSE(chihaya::internal_chunk::inspect(dhandle, H5::PredType::NATIVE_UINT32, values.size()).supported);
+        auto shandle = fhandle.openDataSet("shuffled");
+        EXPECT_FALSE(chihaya::internal_chunk::inspect(shandle, H5::PredType::NATIVE_UINT16, values.size()).supported);
+    }
+}
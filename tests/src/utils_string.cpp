@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+#include "chihaya/utils_string.hpp"
+#include "utils.h"
+
+#include <string>
+#include <vector>
+
+TEST(UtilsString, IsUtf8) {
+    std::string ascii = "ENSG00000139618_ACGTACGTACGT";
+    EXPECT_TRUE(chihaya::internal_string::is_ascii(ascii.c_str(), ascii.size()));
+    EXPECT_TRUE(chihaya::internal_string::is_utf8(ascii.c_str(), ascii.size()));
+
+    std::string accented = "caf\xc3\xa9 na\xc3\xafve \xe2\x82\xac \xf0\x9f\x98\x80 and some more ASCII";
+    EXPECT_FALSE(chihaya::internal_string::is_ascii(accented.c_str(), accented.size()));
+    EXPECT_TRUE(chihaya::internal_string::is_utf8(accented.c_str(), accented.size()));
+
+    std::vector<std::string> invalid {
+        "abc\xff",
+        "truncated \xc3",
+        "bad continuation \xe2\x28\xa1",
+        "overlong \xc0\xaf",
+        "surrogate \xed\xa0\x80",
+        "too large \xf4\x90\x80\x80",
+        "\x80 stray continuation"
+    };
+    for (const auto& x : invalid) {
+        EXPECT_FALSE(chihaya::internal_string::is_utf8(x.c_str(), x.size())) << x;
+    }
+}
+
+TEST(UtilsString, Dataset) {
+    const char* path = "Test_utils_string.h5";
+    std::vector<std::string> values;
+    for (size_t i = 0; i < 100; ++i) {
+        values.push_back("gene_" + std::to_string(i));
+    }
+    values[50] = "g\xc3\xa8ne";
+
+    auto create_variable = [&](const std::vector<std::string>& contents) -> void {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        hsize_t dims[2] = { 20, 5 };
+        H5::DataSpace dspace(2, dims);
+        H5::StrType stype(0, H5T_VARIABLE);
+        stype.setCset(H5T_CSET_UTF8);
+        auto dhandle = fhandle.createDataSet("strings", stype, dspace);
+        std::vector<const char*> ptrs;
+        for (const auto& x : contents) {
+            ptrs.push_back(x.c_str());
+        }
+        dhandle.write(ptrs.data(), stype);
+    };
+
+    auto create_fixed = [&](const std::vector<std::string>& contents) -> void {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        hsize_t n = contents.size();
+        H5::DataSpace dspace(1, &n);
+        size_t len = 10;
+        H5::StrType stype(0, len);
+        stype.setCset(H5T_CSET_UTF8);
+        stype.setStrpad(H5T_STR_NULLPAD);
+        std::vector<char> buffer(len * contents.size());
+        for (size_t i = 0; i < contents.size(); ++i) {
+            std::copy(contents[i].begin(), contents[i].end(), buffer.begin() + i * len);
+        }
+        auto dhandle = fhandle.createDataSet("strings", stype, dspace);
+        dhandle.write(buffer.data(), stype);
+    };
+
+    auto validate = [&](const std::vector<hsize_t>& dims, bool check_utf8) -> void {
+        H5::H5File fhandle(path, H5F_ACC_RDONLY);
+        auto dhandle = fhandle.openDataSet("strings");
+        for (hsize_t bufsize : { 7, 20, 1000 }) {
+            chihaya::internal_string::validate_string_dataset(dhandle, dims, bufsize, check_utf8);
+        }
+    };
+
+    auto expect_invalid = [&](const std::vector<hsize_t>& dims, size_t index, std::string message) -> void {
+        H5::H5File fhandle(path, H5F_ACC_RDONLY);
+        auto dhandle = fhandle.openDataSet("strings");
+        for (hsize_t bufsize : { 7, 20, 1000 }) {
+            try {
+                chihaya::internal_string::validate_string_dataset(dhandle, dims, bufsize, true);
+                ADD_FAILURE() << "expected an error";
+            } catch (chihaya::ValidationError& e) {
+                EXPECT_EQ(e.index(), index);
+                EXPECT_TRUE(std::string(e.what()).find(message) != std::string::npos) << e.what();
+            }
+        }
+    };
+
+    create_variable(values);
+    validate({ 20, 5 }, true);
+    create_fixed(values);
+    validate({ 100 }, true);
+
+    auto copy = values;
+    copy[73] = "bad\xff";
+    copy[88] = "bad\xc3";
+    create_variable(copy);
+    expect_invalid({ 20, 5 }, 73, "UTF-8");
+    validate({ 20, 5 }, false);
+    create_fixed(copy);
+    expect_invalid({ 100 }, 73, "UTF-8");
+    validate({ 100 }, false);
+}
+
+TEST(UtilsString, Arena) {
+    chihaya::internal_string::Arena arena(100);
+
+    auto first = static_cast<char*>(arena.allocate(10));
+    auto second = static_cast<char*>(arena.allocate(10));
+    EXPECT_NE(first, second);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(second) % alignof(std::max_align_t), 0);
+    EXPECT_EQ(arena.num_pages(), 1);
+
+    // Spilling into a new page, or a larger page for big requests.
+    for (int i = 0; i < 10; ++i) {
+        arena.allocate(10);
+    }
+    EXPECT_EQ(arena.num_pages(), 2);
+    arena.allocate(1000);
+    EXPECT_EQ(arena.num_pages(), 3);
+
+    // Pages are reused after a reset.
+    arena.reset();
+    EXPECT_EQ(arena.allocate(10), first);
+    for (int i = 0; i < 12; ++i) {
+        arena.allocate(10);
+    }
+    EXPECT_EQ(arena.num_pages(), 3);
+}
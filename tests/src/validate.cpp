@@ -1,4 +1,6 @@
 #include "utils.h"
+#include <fstream>
+#include <iterator>
 
 chihaya::ArrayDetails test_validate(const std::string& path, const std::string& name) {
     return chihaya::validate(path, name);
@@ -79,3 +81,368 @@ TEST(Validate, Errors) {
     }
     expect_error(path, "seed", "unknown object type 'YAY'");
 }
+
+TEST(Validate, Status) {
+    const char* path = "Test_validate.h5";
+
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto ghandle = operation_opener(fhandle, "WHEE", "transpose");
+        add_version_string(ghandle, 1100000);
+        add_numeric_vector<int>(ghandle, "permutation", { 1, 0 }, H5::PredType::NATIVE_UINT32);
+
+        auto shandle = operation_opener(ghandle, "seed", "subset");
+        auto lhandle = list_opener(shandle, "index", 2, 1100000);
+        add_numeric_vector<int>(lhandle, "1", { 0, 5, 2, 17, 3 }, H5::PredType::NATIVE_UINT32);
+        mock_array_opener(shandle, "seed", { 20, 17 }, 1100000, "INTEGER");
+    }
+
+    {
+        auto status = chihaya::try_validate(path, "WHEE");
+        EXPECT_FALSE(status.valid());
+        EXPECT_EQ(status.error.code(), chihaya::ErrorCode::INVALID_INDEX);
+        EXPECT_EQ(status.error.index(), 3);
+        std::vector<std::string> expected_path { "seed", "index/1" };
+        EXPECT_EQ(status.error.path(), expected_path);
+
+        std::string msg(status.error.what());
+        EXPECT_EQ(msg.rfind("failed to validate delayed operation of type 'transpose'; failed to validate 'seed'", 0), 0);
+        EXPECT_TRUE(msg.find("indices out of range") != std::string::npos);
+
+        // Same message as the throwing version.
+        expect_error([&]() { chihaya::validate(path, "WHEE"); }, msg);
+
+        // Same error when the scans are deferred.
+        chihaya::Options options;
+        options.defer_scans = true;
+        auto deferred = chihaya::try_validate(path, "WHEE", options);
+        EXPECT_EQ(deferred.error.code(), chihaya::ErrorCode::INVALID_INDEX);
+        EXPECT_EQ(deferred.error.index(), 3);
+        EXPECT_EQ(deferred.error.path(), expected_path);
+        EXPECT_EQ(std::string(deferred.error.what()), msg);
+    }
+
+    {
+        H5::H5File fhandle(path, H5F_ACC_RDWR);
+        auto lhandle = fhandle.openGroup("WHEE/seed/index");
+        lhandle.unlink("1");
+        add_numeric_vector<int>(lhandle, "1", { 0, 5, 2, 16, 3 }, H5::PredType::NATIVE_UINT32);
+    }
+
+    {
+        auto status = chihaya::try_validate(path, "WHEE");
+        EXPECT_TRUE(status.valid());
+        EXPECT_EQ(status.error.code(), chihaya::ErrorCode::NONE);
+        EXPECT_EQ(status.details.type, chihaya::INTEGER);
+        std::vector<size_t> expected_dims { 5, 20 };
+        EXPECT_EQ(status.details.dimensions, expected_dims);
+    }
+
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto ghandle = operation_opener(fhandle, "WHEE", "FOO");
+        add_version_string(ghandle, 1100000);
+    }
+
+    {
+        auto status = chihaya::try_validate(path, "WHEE");
+        EXPECT_EQ(status.error.code(), chihaya::ErrorCode::UNKNOWN_TYPE);
+        EXPECT_TRUE(status.error.path().empty());
+        EXPECT_EQ(status.error.index(), chihaya::ValidationError::no_index);
+        EXPECT_EQ(std::string(status.error.what()), "unknown operation type 'FOO'");
+    }
+
+    {
+        auto status = chihaya::try_validate(path, "missing");
+        EXPECT_FALSE(status.valid());
+        EXPECT_EQ(status.error.code(), chihaya::ErrorCode::HDF5_ERROR);
+    }
+}
+
+TEST(Validate, DeferredScans) {
+    const char* path = "Test_validate.h5";
+
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto ghandle = operation_opener(fhandle, "WHEE", "matrix product");
+        add_version_string(ghandle, 1100000);
+
+        auto lhandle = array_opener(ghandle, "left_seed", "sparse matrix");
+        auto dhandle = add_numeric_vector<double>(lhandle, "data", { 1, 2, 3, 4 }, H5::PredType::NATIVE_DOUBLE);
+        add_string_attribute(dhandle, "type", "FLOAT");
+        add_numeric_vector<int>(lhandle, "shape", { 5, 2 }, H5::PredType::NATIVE_UINT32);
+        add_numeric_vector<int>(lhandle, "indices", { 0, 4, 3, 9 }, H5::PredType::NATIVE_UINT32); // last one out of range.
+        add_numeric_vector<int>(lhandle, "indptr", { 0, 2, 4 }, H5::PredType::NATIVE_UINT64);
+        add_numeric_scalar(lhandle, "by_column", 1, H5::PredType::NATIVE_INT8);
+        add_string_scalar(ghandle, "left_orientation", "N");
+
+        mock_array_opener(ghandle, "right_seed", { 3, 7 }, 1100000, "FLOAT");
+        add_string_scalar(ghandle, "right_orientation", "N");
+    }
+
+    // Without deferral, the indices are scanned first.
+    expect_error(path, "WHEE", "number of rows");
+
+    chihaya::Options options;
+    options.defer_scans = true;
+    expect_error([&]() { chihaya::validate(path, "WHEE", options); }, "inconsistent common dimensions");
+    EXPECT_TRUE(options.deferred_scans.empty());
+
+    // Once the cheap checks pass, the deferred scans are run.
+    {
+        H5::H5File fhandle(path, H5F_ACC_RDWR);
+        auto ghandle = fhandle.openGroup("WHEE");
+        ghandle.unlink("right_seed");
+        mock_array_opener(ghandle, "right_seed", { 2, 7 }, 1100000, "FLOAT");
+    }
+    expect_error([&]() { chihaya::validate(path, "WHEE", options); }, "failed to validate 'left_seed'; failed to validate delayed array of type 'sparse matrix'; entries of 'indices'");
+    EXPECT_TRUE(options.deferred_scans.empty());
+
+    // Same error as without deferral.
+    {
+        auto deferred = chihaya::try_validate(path, "WHEE", options);
+        chihaya::Options eager_options;
+        auto eager = chihaya::try_validate(path, "WHEE", eager_options);
+        EXPECT_FALSE(deferred.valid());
+        EXPECT_EQ(deferred.error.code(), eager.error.code());
+        EXPECT_EQ(deferred.error.index(), eager.error.index());
+        EXPECT_EQ(deferred.error.path(), eager.error.path());
+        std::vector<std::string> expected_path { "left_seed" };
+        EXPECT_EQ(deferred.error.path(), expected_path);
+        EXPECT_EQ(std::string(deferred.error.what()), std::string(eager.error.what()));
+    }
+
+    {
+        H5::H5File fhandle(path, H5F_ACC_RDWR);
+        auto lhandle = fhandle.openGroup("WHEE/left_seed");
+        lhandle.unlink("indices");
+        add_numeric_vector<int>(lhandle, "indices", { 0, 4, 3, 4 }, H5::PredType::NATIVE_UINT32);
+    }
+    {
+        H5::H5File fhandle(path, H5F_ACC_RDONLY);
+        auto ghandle = fhandle.openGroup("WHEE");
+        auto output = chihaya::validate(ghandle, ritsuko::Version(1, 1, 0), options);
+        EXPECT_EQ(options.deferred_scans.size(), 1);
+        EXPECT_EQ(options.deferred_scans.front().name, "/WHEE/left_seed/indices");
+        EXPECT_EQ(options.deferred_scans.front().size, 4);
+        chihaya::run_deferred_scans(options);
+        EXPECT_TRUE(options.deferred_scans.empty());
+
+        EXPECT_EQ(output.type, chihaya::FLOAT);
+        std::vector<size_t> expected_dims { 5, 7 };
+        EXPECT_EQ(output.dimensions, expected_dims);
+    }
+}
+
+TEST(Validate, ParallelDeferredScans) {
+    const char* path = "Test_validate.h5";
+    int nseeds = 20;
+
+    auto create = [&](int bad) -> void {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto ghandle = operation_opener(fhandle, "WHEE", "combine");
+        add_version_string(ghandle, 1100000);
+        add_numeric_scalar(ghandle, "along", 1, H5::PredType::NATIVE_UINT32);
+
+        auto lhandle = list_opener(ghandle, "seeds", nseeds, 1100000);
+        for (int s = 0; s < nseeds; ++s) {
+            auto shandle = array_opener(lhandle, std::to_string(s), "sparse matrix");
+            std::vector<int> indices { 0, 2, 1, 4 + s };
+            if (s == bad) {
+                indices[1] = 0; // not sorted.
+            }
+            std::vector<int> indptr { 0, 2, 4 };
+
+            // Chunking to avoid the memory-mapped fast path.
+            hsize_t n = indices.size(), chunk = 2;
+            H5::DSetCreatPropList cplist;
+            cplist.setChunk(1, &chunk);
+            H5::DataSpace dspace(1, &n);
+            auto ihandle = shandle.createDataSet("indices", H5::PredType::NATIVE_UINT16, dspace, cplist);
+            ihandle.write(indices.data(), H5::PredType::NATIVE_INT);
+
+            auto dhandle = add_numeric_vector<double>(shandle, "data", { 1, 2, 3, 4 }, H5::PredType::NATIVE_DOUBLE);
+            add_string_attribute(dhandle, "type", "FLOAT");
+            add_numeric_vector<int>(shandle, "shape", { 100, 2 }, H5::PredType::NATIVE_UINT32);
+            add_numeric_vector<int>(shandle, "indptr", indptr, H5::PredType::NATIVE_UINT64);
+            add_numeric_scalar(shandle, "by_column", 1, H5::PredType::NATIVE_INT8);
+        }
+    };
+
+    chihaya::Options options;
+    options.defer_scans = true;
+    options.num_threads = 4;
+
+    create(-1);
+    auto output = chihaya::validate(path, "WHEE", options);
+    EXPECT_EQ(output.dimensions[0], 100);
+    EXPECT_EQ(output.dimensions[1], nseeds * 2);
+
+    create(13);
+    expect_error([&]() { chihaya::validate(path, "WHEE", options); }, "failed to validate 'seeds/13'; failed to validate delayed array of type 'sparse matrix'; 'indices' should be strictly increasing");
+    EXPECT_TRUE(options.deferred_scans.empty());
+
+    auto deferred = chihaya::try_validate(path, "WHEE", options);
+    std::vector<std::string> expected_path { "seeds/13" };
+    EXPECT_EQ(deferred.error.path(), expected_path);
+    chihaya::Options eager_options;
+    auto eager = chihaya::try_validate(path, "WHEE", eager_options);
+    EXPECT_EQ(deferred.error.path(), eager.error.path());
+    EXPECT_EQ(std::string(deferred.error.what()), std::string(eager.error.what()));
+}
+
+TEST(Validate, FileAccess) {
+    const char* path = "Test_validate.h5";
+
+    auto create = [&](bool paged) -> void {
+        H5::FileCreatPropList fcpl;
+        if (paged) {
+            H5Pset_file_space_strategy(fcpl.getId(), H5F_FSPACE_STRATEGY_PAGE, 0, 1);
+        }
+        H5::H5File fhandle(path, H5F_ACC_TRUNC, fcpl);
+        auto ghandle = operation_opener(fhandle, "WHEE", "combine");
+        add_version_string(ghandle, 1100000);
+        add_numeric_scalar(ghandle, "along", 0, H5::PredType::NATIVE_UINT32);
+        auto lhandle = list_opener(ghandle, "seeds", 50, 1100000);
+        for (int s = 0; s < 50; ++s) {
+            mock_array_opener(lhandle, std::to_string(s), { 2, 10 }, 1100000, "INTEGER");
+        }
+    };
+
+    std::vector<chihaya::FileAccessOptions> settings(4);
+    settings[1].metadata_cache_size = 64 * 1024 * 1024;
+    settings[2].page_buffer_size = 1024 * 1024;
+    settings[3].core_driver_threshold = 100 * 1024 * 1024;
+    settings[3].metadata_cache_size = 1024 * 1024;
+    settings[3].page_buffer_size = 1024 * 1024;
+
+    for (int paged = 0; paged < 2; ++paged) {
+        create(paged);
+        for (const auto& s : settings) {
+            chihaya::Options options;
+            options.file_access = s;
+            auto output = chihaya::validate(path, "WHEE", options);
+            EXPECT_EQ(output.type, chihaya::INTEGER);
+            std::vector<size_t> expected_dims { 100, 10 };
+            EXPECT_EQ(output.dimensions, expected_dims);
+
+            auto status = chihaya::try_validate(path, "WHEE", options);
+            EXPECT_TRUE(status.valid());
+        }
+    }
+
+    chihaya::Options options;
+    options.file_access.core_driver_threshold = 100;
+    EXPECT_ANY_THROW(chihaya::validate("missing.h5", "WHEE", options));
+}
+
+TEST(Validate, PageBuffer) {
+    const char* path = "Test_validate.h5";
+
+    auto get_page_buffer_size = [](const H5::H5File& handle) -> size_t {
+        size_t buf_size;
+        unsigned min_meta, min_raw;
+        H5Pget_page_buffer_size(handle.getAccessPlist().getId(), &buf_size, &min_meta, &min_raw);
+        return buf_size;
+    };
+
+    for (int paged = 0; paged < 2; ++paged) {
+        {
+            H5::FileCreatPropList fcpl;
+            if (paged) {
+                H5Pset_file_space_strategy(fcpl.getId(), H5F_FSPACE_STRATEGY_PAGE, 0, 1);
+                H5Pset_file_space_page_size(fcpl.getId(), 4096);
+            }
+            H5::H5File fhandle(path, H5F_ACC_TRUNC, fcpl);
+            auto ghandle = operation_opener(fhandle, "WHEE", "transpose");
+            add_version_string(ghandle, 1100000);
+            add_numeric_vector<int>(ghandle, "permutation", { 1, 0 }, H5::PredType::NATIVE_UINT32);
+            mock_array_opener(ghandle, "seed", { 10, 5 }, 1100000, "INTEGER");
+        }
+
+        // Non-paged files are opened without a page buffer, rather than
+        // relying on HDF5 to fail and falling back to a second attempt.
+        chihaya::FileAccessOptions settings;
+        settings.page_buffer_size = 1024 * 1024;
+        EXPECT_EQ(chihaya::internal_file::supports_page_buffer(path, settings.page_buffer_size), static_cast<bool>(paged));
+        {
+            auto handle = chihaya::internal_file::open(path, settings);
+            EXPECT_EQ(get_page_buffer_size(handle), paged ? settings.page_buffer_size : 0);
+        }
+
+        // Buffers smaller than a page are ignored.
+        settings.page_buffer_size = 1024;
+        EXPECT_FALSE(chihaya::internal_file::supports_page_buffer(path, settings.page_buffer_size));
+        {
+            auto handle = chihaya::internal_file::open(path, settings);
+            EXPECT_EQ(get_page_buffer_size(handle), 0);
+        }
+
+        chihaya::Options options;
+        options.file_access.page_buffer_size = 1024 * 1024;
+        auto output = chihaya::validate(path, "WHEE", options);
+        std::vector<size_t> expected_dims { 5, 10 };
+        EXPECT_EQ(output.dimensions, expected_dims);
+    }
+}
+
+TEST(Validate, FileImage) {
+    const char* path = "Test_validate.h5";
+
+    {
+        H5::H5File fhandle(path, H5F_ACC_TRUNC);
+        auto ghandle = operation_opener(fhandle, "WHEE", "transpose");
+        add_version_string(ghandle, 1100000);
+        add_numeric_vector<int>(ghandle, "permutation", { 1, 0 }, H5::PredType::NATIVE_UINT32);
+
+        auto shandle = operation_opener(ghandle, "seed", "subset");
+        auto lhandle = list_opener(shandle, "index", 2, 1100000);
+        add_numeric_vector<int>(lhandle, "1", { 0, 5, 2, 17, 3 }, H5::PredType::NATIVE_UINT32);
+        mock_array_opener(shandle, "seed", { 20, 17 }, 1100000, "INTEGER");
+    }
+
+    auto load = [&]() -> std::vector<char> {
+        std::ifstream input(path, std::ios::binary);
+        return std::vector<char>(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+    };
+
+    {
+        auto image = load();
+        auto status = chihaya::try_validate(image.data(), image.size(), "WHEE");
+        EXPECT_FALSE(status.valid());
+        EXPECT_EQ(status.error.code(), chihaya::ErrorCode::INVALID_INDEX);
+        expect_error([&]() { chihaya::validate(image.data(), image.size(), "WHEE"); }, status.error.what());
+    }
+
+    {
+        H5::H5File fhandle(path, H5F_ACC_RDWR);
+        auto lhandle = fhandle.openGroup("WHEE/seed/index");
+        lhandle.unlink("1");
+        add_numeric_vector<int>(lhandle, "1", { 0, 5, 2, 16, 3 }, H5::PredType::NATIVE_UINT32);
+    }
+
+    {
+        auto image = load();
+        chihaya::Options options;
+        options.file_access.metadata_cache_size = 1024 * 1024;
+        auto output = chihaya::validate(image.data(), image.size(), "WHEE", options);
+        EXPECT_EQ(output.type, chihaya::INTEGER);
+        std::vector<size_t> expected_dims { 5, 20 };
+        EXPECT_EQ(output.dimensions, expected_dims);
+
+        // Multiple images can be open at the same time.
+        auto copy = image;
+        auto status = chihaya::try_validate(copy.data(), copy.size(), "WHEE", options);
+        EXPECT_TRUE(status.valid());
+        EXPECT_EQ(status.details.dimensions, expected_dims);
+
+        auto missing = chihaya::try_validate(image.data(), image.size(), "missing");
+        EXPECT_EQ(missing.error.code(), chihaya::ErrorCode::HDF5_ERROR);
+    }
+
+    {
+        std::vector<char> image(1000, 'a');
+        auto status = chihaya::try_validate(image.data(), image.size(), "WHEE");
+        EXPECT_EQ(status.error.code(), chihaya::ErrorCode::HDF5_ERROR);
+    }
+}